@@ -1,12 +1,17 @@
 #ifndef ALLOCATOR_H_
 #define ALLOCATOR_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <new>
+#include <type_traits>
 
 namespace ns {
 
 template <typename T>
-class LinearAllocator {
+class allocator {
  public:
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
@@ -15,12 +20,13 @@ class LinearAllocator {
   using const_pointer = const value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
+  using is_always_equal = std::true_type;
 
-  LinearAllocator() throw(){};
-  LinearAllocator(const LinearAllocator&) throw(){};
+  allocator() throw(){};
+  allocator(const allocator&) throw(){};
   template <typename U>
-  LinearAllocator(const LinearAllocator<U>&) throw(){};
-  ~LinearAllocator(){};
+  allocator(const allocator<U>&) throw(){};
+  ~allocator(){};
 
   pointer address(reference value) const { return &value; }
   const_pointer address(const_reference value) const { return &value; }
@@ -54,12 +60,182 @@ class LinearAllocator {
     return std::numeric_limits<size_type>::max() / sizeof(value_type);
   }
 
+  template <typename U>
+  struct rebind {
+    using other = allocator<U>;
+  };
+};
+
+template <typename T, typename U>
+bool operator==(const allocator<T>&, const allocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const allocator<T>&, const allocator<U>&) {
+  return false;
+}
+
+// Monotonic arena: memory is handed out by bumping a pointer through a list
+// of chunks and is only given back all at once. reset() rewinds to the first
+// chunk in O(1) and keeps the chunks for reuse, release() frees them.
+// Not thread safe.
+class LinearArena {
+ public:
+  static constexpr std::size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit LinearArena(std::size_t chunk_size = kDefaultChunkSize)
+      : chunk_size_(chunk_size), head_(nullptr), curr_(nullptr), offset_(0) {}
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+  ~LinearArena() { release(); }
+
+  void* allocate(std::size_t bytes, std::size_t align) {
+    void* ptr = curr_ ? Bump(bytes, align) : nullptr;
+    return (ptr ? ptr : Refill(bytes, align));
+  }
+
+  void reset() {
+    curr_ = head_;
+    offset_ = 0;
+  }
+
+  void release() {
+    while (head_ != nullptr) {
+      Chunk* next = head_->next;
+      ::operator delete(head_);
+      head_ = next;
+    }
+    curr_ = nullptr;
+    offset_ = 0;
+  }
+
+  std::size_t chunk_size() const { return chunk_size_; }
+
+ private:
+  struct alignas(std::max_align_t) Chunk {
+    Chunk* next;
+    std::size_t size;
+  };
+
+  std::size_t chunk_size_;
+  Chunk* head_;
+  Chunk* curr_;
+  std::size_t offset_;
+
+  void* Bump(std::size_t bytes, std::size_t align) {
+    std::uintptr_t data = reinterpret_cast<std::uintptr_t>(curr_ + 1);
+    std::uintptr_t first = (data + offset_ + align - 1) & ~(align - 1);
+    if (first + bytes > data + curr_->size) return nullptr;
+    offset_ = first + bytes - data;
+    return reinterpret_cast<void*>(first);
+  }
+
+  // Moves on to the next chunk kept by reset() or links in a new one.
+  void* Refill(std::size_t bytes, std::size_t align) {
+    while (curr_ != nullptr && curr_->next != nullptr) {
+      curr_ = curr_->next;
+      offset_ = 0;
+      if (void* ptr = Bump(bytes, align)) return ptr;
+    }
+    std::size_t size = bytes + align;
+    if (size < chunk_size_) size = chunk_size_;
+    Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+    chunk->next = nullptr;
+    chunk->size = size;
+    if (curr_ != nullptr)
+      curr_->next = chunk;
+    else
+      head_ = chunk;
+    curr_ = chunk;
+    offset_ = 0;
+    return Bump(bytes, align);
+  }
+};
+
+// Allocates from a shared LinearArena. Copies and rebound copies point at
+// the same arena, which lives until the last of them is gone; deallocate()
+// is a no-op. Containers take the arena along on move assignment and swap,
+// and keep their own on copy assignment.
+template <typename T>
+class LinearAllocator {
+ public:
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  LinearAllocator() : arena_(std::make_shared<LinearArena>()){};
+  explicit LinearAllocator(std::size_t chunk_size)
+      : arena_(std::make_shared<LinearArena>(chunk_size)){};
+  explicit LinearAllocator(std::shared_ptr<LinearArena> arena)
+      : arena_(std::move(arena)){};
+  LinearAllocator(const LinearAllocator&) = default;
+  template <typename U>
+  LinearAllocator(const LinearAllocator<U>& other) : arena_(other.arena()){};
+  ~LinearAllocator(){};
+
+  LinearAllocator& operator=(const LinearAllocator&) = default;
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+
+  pointer allocate(size_type n) {
+    if (n > max_size()) throw std::bad_array_new_length();
+    return static_cast<pointer>(
+        arena_->allocate(n * sizeof(value_type), alignof(value_type)));
+  }
+
+  void deallocate(void* ptr, size_type n) {
+    (void)ptr;
+    (void)n;
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  size_type max_size() const noexcept {
+    return std::numeric_limits<size_type>::max() / sizeof(value_type);
+  }
+
+  // Makes all memory handed out so far reusable. Every container sharing
+  // the arena has to be empty or gone.
+  void reset() { arena_->reset(); }
+
+  const std::shared_ptr<LinearArena>& arena() const { return arena_; }
+
   template <typename U>
   struct rebind {
     using other = LinearAllocator<U>;
   };
+
+ private:
+  std::shared_ptr<LinearArena> arena_;
 };
 
+template <typename T, typename U>
+bool operator==(const LinearAllocator<T>& lhs, const LinearAllocator<U>& rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const LinearAllocator<T>& lhs, const LinearAllocator<U>& rhs) {
+  return !(lhs == rhs);
+}
+
 }  // namespace ns
 
 #endif  // ALLOCATOR_H_
@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+
+#include "../containers.h"
+#include "../containersplus.h"
+
+// Every thread builds and tears down its own map and list, which is the
+// pattern that makes malloc contention show up in NewNode.
+
+template <template <typename> class Alloc>
+static void BM_PerThreadContainers(benchmark::State& state) {
+  using map_type =
+      ns::map<int, int, std::less<int>, Alloc<std::pair<int, int>>>;
+  using list_type = ns::list<int, Alloc<int>>;
+  const int n = state.range(0);
+  for (auto _ : state) {
+    map_type map;
+    list_type list;
+    for (int i = 0; i < n; ++i) {
+      map.insert(i * 7919 % n, i);
+      list.push_back(i);
+    }
+    for (int i = 0; i < n; i += 2) list.pop_front();
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n * 2);
+}
+
+BENCHMARK_TEMPLATE(BM_PerThreadContainers, ns::allocator)
+    ->Arg(1 << 12)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PerThreadContainers, ns::LinearAllocator)
+    ->Arg(1 << 12)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PerThreadContainers, ns::ThreadCacheAllocator)
+    ->Arg(1 << 12)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+
+#include "../containers.h"
+#include "../containersplus.h"
+
+// Same map and vector workload through the default allocator and through
+// polymorphic_allocator over each memory resource, to price the virtual
+// dispatch against what the resource saves.
+
+enum Resource { kNewDelete, kMonotonic, kPool, kSyncPool };
+
+static void Workload(ns::pmr::memory_resource* resource, int n) {
+  ns::pmr::map<int, int> map(resource);
+  ns::pmr::vector<int> vector(resource);
+  for (int i = 0; i < n; ++i) {
+    map.insert(i * 7919 % n, i);
+    vector.push_back(i);
+  }
+  benchmark::DoNotOptimize(map.size());
+  benchmark::DoNotOptimize(vector.data());
+}
+
+static void BM_DefaultAllocator(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    ns::map<int, int> map;
+    ns::vector<int> vector;
+    for (int i = 0; i < n; ++i) {
+      map.insert(i * 7919 % n, i);
+      vector.push_back(i);
+    }
+    benchmark::DoNotOptimize(map.size());
+    benchmark::DoNotOptimize(vector.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+template <Resource kind>
+static void BM_Pmr(benchmark::State& state) {
+  const int n = state.range(0);
+  ns::pmr::unsynchronized_pool_resource pool;
+  ns::pmr::synchronized_pool_resource sync_pool;
+  for (auto _ : state) {
+    if constexpr (kind == kNewDelete) {
+      Workload(ns::pmr::new_delete_resource(), n);
+    } else if constexpr (kind == kMonotonic) {
+      ns::pmr::monotonic_buffer_resource arena;
+      Workload(&arena, n);
+    } else if constexpr (kind == kPool) {
+      Workload(&pool, n);
+    } else {
+      Workload(&sync_pool, n);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_DefaultAllocator)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Pmr, kNewDelete)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Pmr, kMonotonic)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Pmr, kPool)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Pmr, kSyncPool)->Arg(1 << 10)->Arg(1 << 16);
+
+BENCHMARK_MAIN();
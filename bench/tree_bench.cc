@@ -0,0 +1,313 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../containers.h"
+#include "../containersplus.h"
+
+// Appending increasing keys, the shape of a time-ordered event log, with
+// and without end() as the hint.
+
+static void BM_AppendPlain(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    ns::map<long, int> map;
+    for (int i = 0; i < n; ++i) map.insert(std::make_pair(long(i), i));
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_AppendHinted(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    ns::map<long, int> map;
+    for (int i = 0; i < n; ++i) map.emplace_hint(map.cend(), long(i), i);
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_AppendPlain)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK(BM_AppendHinted)->Arg(1 << 10)->Arg(1 << 16);
+
+// String-keyed map lookups and repeated inserts with a two-way and a
+// three-way comparator. Keys share a long prefix, so every comparison is a
+// real memcmp; cmp/op reports the comparator calls per operation.
+
+static long comparisons = 0;
+
+struct StringLess {
+  bool operator()(const std::string& a, const std::string& b) const {
+    ++comparisons;
+    return a < b;
+  }
+};
+
+struct StringThreeWay : StringLess {
+  int compare(const std::string& a, const std::string& b) const {
+    ++comparisons;
+    return a.compare(b);
+  }
+};
+
+template <typename Compare>
+static void BM_StringMap(benchmark::State& state) {
+  const int n = state.range(0);
+  std::vector<std::string> keys;
+  for (int i = 0; i < n; ++i)
+    keys.push_back("/var/log/service/events/" + std::to_string(i * 7919 % n));
+  ns::map<std::string, int, Compare> map;
+  for (int i = 0; i < n; ++i) map.insert(keys[i], i);
+  comparisons = 0;
+  for (auto _ : state) {
+    for (const std::string& key : keys) {
+      benchmark::DoNotOptimize(map.contains(key));
+      benchmark::DoNotOptimize(map.insert(key, 0));
+    }
+  }
+  const double ops = double(state.iterations()) * n * 2;
+  state.counters["cmp/op"] = comparisons / ops;
+  state.SetItemsProcessed(state.iterations() * n * 2);
+}
+
+BENCHMARK_TEMPLATE(BM_StringMap, StringLess)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_StringMap, StringThreeWay)->Arg(1 << 10)->Arg(1 << 16);
+
+// Erasing every element of a map in scattered order, small values against
+// 4 KiB ones. Erase relinks nodes instead of moving values, so what is left
+// of the gap is the cost of freeing larger blocks. The iterators collected
+// up front stay valid throughout.
+
+template <std::size_t Size>
+static void BM_EraseScattered(benchmark::State& state) {
+  using map_type = ns::map<int, std::array<char, Size>>;
+  const int n = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    map_type map;
+    for (int i = 0; i < n; ++i)
+      map.insert(i, typename map_type::mapped_type());
+    std::vector<typename map_type::iter> order;
+    for (auto it = map.begin(); it != map.end(); ++it) order.push_back(it);
+    for (int i = 0; i < n; ++i) std::swap(order[i], order[i * 7919 % n]);
+    state.ResumeTiming();
+    for (auto it : order) map.erase(it);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK_TEMPLATE(BM_EraseScattered, 8)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(BM_EraseScattered, 4096)->Arg(1 << 12);
+
+// Expiring the oldest half of a time-ordered map: single erases against
+// one range erase.
+
+static void BM_ExpireOneByOne(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    ns::map<long, int> map;
+    for (int i = 0; i < n; ++i) map.emplace_hint(map.cend(), long(i), i);
+    state.ResumeTiming();
+    for (int i = 0; i < n / 2; ++i) map.erase(map.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * (n / 2));
+}
+
+static void BM_ExpireRange(benchmark::State& state) {
+  const int n = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    ns::map<long, int> map;
+    for (int i = 0; i < n; ++i) map.emplace_hint(map.cend(), long(i), i);
+    auto last = map.find(n / 2);
+    state.ResumeTiming();
+    map.erase(map.cbegin(), last);
+  }
+  state.SetItemsProcessed(state.iterations() * (n / 2));
+}
+
+BENCHMARK(BM_ExpireOneByOne)->Arg(1 << 16);
+BENCHMARK(BM_ExpireRange)->Arg(1 << 16);
+
+// Heap bytes per element, counted through a polymorphic_allocator, and the
+// cost of a full scan. String keys stay within the small-string buffer, so
+// only tree nodes are counted.
+
+class CountingResource : public ns::pmr::memory_resource {
+ public:
+  std::size_t bytes = 0;
+
+ private:
+  void* do_allocate(std::size_t size, std::size_t align) override {
+    bytes += size;
+    return ns::pmr::new_delete_resource()->allocate(size, align);
+  }
+
+  void do_deallocate(void* ptr, std::size_t size,
+                     std::size_t align) override {
+    bytes -= size;
+    ns::pmr::new_delete_resource()->deallocate(ptr, size, align);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+template <typename Alloc>
+static void Fill(ns::set<int, std::less<int>, Alloc>& set, int i) {
+  set.insert(i);
+}
+template <typename Alloc>
+static void Fill(ns::map<int, int, std::less<int>, Alloc>& map, int i) {
+  map.insert(i, i);
+}
+template <typename Alloc>
+static void Fill(ns::map<std::string, int, std::less<std::string>, Alloc>& map,
+                 int i) {
+  map.insert(std::to_string(i), i);
+}
+
+template <typename Container>
+static void BM_Footprint(benchmark::State& state) {
+  const int n = state.range(0);
+  CountingResource resource;
+  Container container(&resource);
+  for (int i = 0; i < n; ++i) Fill(container, i * 7919 % n);
+  for (auto _ : state) {
+    long visited = 0;
+    for (auto it = container.begin(); it != container.end(); ++it) ++visited;
+    benchmark::DoNotOptimize(visited);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  state.counters["bytes/elem"] = double(resource.bytes) / n;
+}
+
+BENCHMARK_TEMPLATE(BM_Footprint, ns::pmr::set<int>)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Footprint, ns::pmr::map<int, int>)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Footprint, ns::pmr::map<std::string, int>)
+    ->Arg(1 << 16);
+
+// The same with index-linked nodes, counted off the IndexArena; the tree's
+// header is included.
+
+template <typename Container>
+static void BM_IndexFootprint(benchmark::State& state) {
+  const int n = state.range(0);
+  std::size_t before = ns::IndexArena::in_use();
+  Container container;
+  for (int i = 0; i < n; ++i) Fill(container, i * 7919 % n);
+  for (auto _ : state) {
+    long visited = 0;
+    for (auto it = container.begin(); it != container.end(); ++it) ++visited;
+    benchmark::DoNotOptimize(visited);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  state.counters["bytes/elem"] =
+      double(ns::IndexArena::in_use() - before) / n;
+}
+
+BENCHMARK_TEMPLATE(BM_IndexFootprint,
+                   ns::set<int, std::less<int>, ns::IndexPoolAllocator<int>>)
+    ->Arg(1 << 16);
+BENCHMARK_TEMPLATE(
+    BM_IndexFootprint,
+    ns::map<int, int, std::less<int>,
+            ns::IndexPoolAllocator<std::pair<int, int>>>)
+    ->Arg(1 << 16);
+BENCHMARK_TEMPLATE(
+    BM_IndexFootprint,
+    ns::map<std::string, int, std::less<std::string>,
+            ns::IndexPoolAllocator<std::pair<std::string, int>>>)
+    ->Arg(1 << 16);
+
+// Full scans summing the mapped values, through the iterators and through
+// for_each. Keys go in shuffled, so neighbours in key order are scattered
+// over the heap.
+
+static void Shuffled(ns::map<int, long>& map, int n) {
+  for (long i = 0; i < n; ++i) map.insert(int(i * 2654435761u % n), i);
+}
+
+static void BM_ScanIterators(benchmark::State& state) {
+  const int n = state.range(0);
+  ns::map<int, long> map;
+  Shuffled(map, n);
+  for (auto _ : state) {
+    long sum = 0;
+    for (auto it = map.begin(); it != map.end(); ++it) sum += (*it).second;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_ScanForEach(benchmark::State& state) {
+  const int n = state.range(0);
+  ns::map<int, long> map;
+  Shuffled(map, n);
+  for (auto _ : state) {
+    long sum = 0;
+    map.for_each(
+        [&sum](const std::pair<int, long>& entry) { sum += entry.second; });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_ScanIterators)->Arg(1 << 16)->Arg(1 << 22);
+BENCHMARK(BM_ScanForEach)->Arg(1 << 16)->Arg(1 << 22);
+
+// Random lookups in a set of 1 << 24 ints, about 512 MiB of nodes, so
+// nearly every level of a descent below the top misses the last-level
+// cache. 4096 keys per batch, half of them present.
+
+static const ns::set<int>& BigSet() {
+  static const ns::set<int> set = [] {
+    std::vector<int> keys(1 << 24);
+    for (int i = 0; i < int(keys.size()); ++i) keys[i] = 2 * i;
+    return ns::set<int>(ns::sorted_unique, keys.begin(), keys.end());
+  }();
+  return set;
+}
+
+static std::vector<int> Probes(int n) {
+  std::vector<int> probes(n);
+  unsigned state = 12345;
+  for (int& key : probes) {
+    state = state * 1103515245u + 12345u;
+    key = int(state >> 6) % (2 << 24);
+  }
+  return probes;
+}
+
+static void BM_FindLoop(benchmark::State& state) {
+  const ns::set<int>& set = BigSet();
+  std::vector<int> probes = Probes(state.range(0));
+  std::vector<bool> present(probes.size());
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < probes.size(); ++i)
+      present[i] = set.contains(probes[i]);
+    benchmark::DoNotOptimize(present);
+  }
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+
+static void BM_FindBatch(benchmark::State& state) {
+  const ns::set<int>& set = BigSet();
+  std::vector<int> probes = Probes(state.range(0));
+  std::vector<bool> present(probes.size());
+  for (auto _ : state) {
+    set.contains_batch(probes, present.begin());
+    benchmark::DoNotOptimize(present);
+  }
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+
+BENCHMARK(BM_FindLoop)->Arg(4096);
+BENCHMARK(BM_FindBatch)->Arg(4096);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "../containers.h"
+
+// Each iteration inserts one element at the given position and erases it
+// again, so the vector stays at state.range(0) elements.
+
+enum Position { kFront, kMiddle, kBack };
+
+template <typename Vector>
+static typename Vector::iter At(Vector& v, Position pos) {
+  if (pos == kFront) return v.begin();
+  if (pos == kMiddle) return v.begin() + v.size() / 2;
+  return v.end();
+}
+
+template <typename Vector>
+static typename Vector::iterator StdAt(Vector& v, Position pos) {
+  if (pos == kFront) return v.begin();
+  if (pos == kMiddle) return v.begin() + v.size() / 2;
+  return v.end();
+}
+
+template <typename T>
+static T Value(int i) {
+  return T(i);
+}
+
+template <>
+std::string Value<std::string>(int i) {
+  return std::string(32, 'a' + i % 26);
+}
+
+template <typename T, Position Pos>
+static void BM_InsertErase(benchmark::State& state) {
+  ns::vector<T> v;
+  for (int i = 0; i < state.range(0); ++i) v.push_back(Value<T>(i));
+  T val = Value<T>(-1);
+  for (auto _ : state) {
+    auto it = v.insert(At(v, Pos), val);
+    v.erase(it);
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+template <typename T, Position Pos>
+static void BM_StdInsertErase(benchmark::State& state) {
+  std::vector<T> v;
+  for (int i = 0; i < state.range(0); ++i) v.push_back(Value<T>(i));
+  T val = Value<T>(-1);
+  for (auto _ : state) {
+    auto it = v.insert(StdAt(v, Pos), val);
+    v.erase(it);
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+#define VECTOR_BENCH(T, Pos)                    \
+  BENCHMARK_TEMPLATE(BM_InsertErase, T, Pos)    \
+      ->Arg(1 << 10)                            \
+      ->Arg(1 << 20);                           \
+  BENCHMARK_TEMPLATE(BM_StdInsertErase, T, Pos) \
+      ->Arg(1 << 10)                            \
+      ->Arg(1 << 20);
+
+VECTOR_BENCH(int, kFront)
+VECTOR_BENCH(int, kMiddle)
+VECTOR_BENCH(int, kBack)
+VECTOR_BENCH(std::string, kFront)
+VECTOR_BENCH(std::string, kMiddle)
+VECTOR_BENCH(std::string, kBack)
+
+BENCHMARK_MAIN();
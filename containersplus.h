@@ -2,6 +2,9 @@
 #define INCLUDE_CONTAINERSPLUS_H_
 
 #include "array.h"
+#include "memory_resource.h"
 #include "multiset.h"
+#include "pool.h"
+#include "tcache.h"
 
 #endif  // INCLUDE_CONTAINERSPLUS_H_
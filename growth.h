@@ -0,0 +1,44 @@
+#ifndef GROWTH_H_
+#define GROWTH_H_
+
+#include <cstddef>
+
+namespace ns {
+
+// Growth policies decide how ns::vector resizes its buffer. grow() returns
+// the capacity to allocate once `required` elements no longer fit into `cap`,
+// shrink() returns the capacity to fall back to after elements are removed
+// (`cap` itself keeps the buffer). The growth factor is Num / Den.
+
+template <std::size_t Num = 2, std::size_t Den = 1>
+struct HysteresisGrowth {
+  static_assert(Num > Den, "growth factor must be greater than one");
+
+  static std::size_t grow(std::size_t cap, std::size_t required) {
+    std::size_t next = cap * Num / Den;
+    return (next < required ? required : next);
+  }
+
+  // Gives back one growth step only when the buffer has dropped below a
+  // factor squared of its capacity, so a size hovering around a boundary
+  // does not reallocate on every push/pop.
+  static std::size_t shrink(std::size_t size, std::size_t cap) {
+    std::size_t prev = cap * Den / Num;
+    return (size < prev * Den / Num ? prev : cap);
+  }
+};
+
+template <std::size_t Num = 2, std::size_t Den = 1>
+struct NoShrinkGrowth {
+  static_assert(Num > Den, "growth factor must be greater than one");
+
+  static std::size_t grow(std::size_t cap, std::size_t required) {
+    return HysteresisGrowth<Num, Den>::grow(cap, required);
+  }
+
+  static std::size_t shrink(std::size_t, std::size_t cap) { return cap; }
+};
+
+}  // namespace ns
+
+#endif  // GROWTH_H_
@@ -1,26 +1,29 @@
 #ifndef ITERATOR_H_
 #define ITERATOR_H_
 
+#include <iterator>
+#include <type_traits>
+
 #include "utils.h"
 
 namespace ns {
 
 template <typename T>
-<<<<<<< HEAD
 class RAIter {  // universal random access iterator for the vector, array, stack and queue 
-=======
-class RAIter {  // uneversal random access iterator for the vector, array, stack and queue 
->>>>>>> 97c2e65... The comments added in iterator.h
  public:
+  using iterator_category = std::random_access_iterator_tag;
   using value_type = T;
-  using difference_type = ptrdiff_t;
+  using difference_type = std::ptrdiff_t;
   using pointer = value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
 
   RAIter() : elem_(nullptr){};
   RAIter(const pointer other) : elem_(other){};
-  RAIter(const RAIter<typename remove_cv<T>::type>& other) : elem_(&(*other)){};
+  RAIter(const RAIter& other) : elem_(other.elem_){};
+  template <typename U, typename = typename ns::enable_if<
+                            std::is_same<const U, T>::value>::type>
+  RAIter(const RAIter<U>& other) : elem_(&(*other)){};
   ~RAIter(){};
 
   RAIter& operator=(const RAIter& other) {
@@ -111,22 +114,24 @@ RAIter<T> operator-(const typename RAIter<T>::difference_type lhs,
 }
 
 template <typename T, typename Node>
-<<<<<<< HEAD
 class BDIter {  // universal bidirectional iterator for the red-black tree, map, set, multiset and list
-=======
-class BDIter {  // universal bidirectional iterator for the rb tree, map, set, multiset and list
->>>>>>> 97c2e65... The comments added in iterator.h
  public:
+  using iterator_category = std::bidirectional_iterator_tag;
   using value_type = T;
+  using difference_type = std::ptrdiff_t;
   using pointer = value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
   using node_type = Node;
   using node_pointer = node_type*;
+  using link_pointer = typename node_type::link_pointer;
 
   BDIter() : elem_(nullptr){};
-  BDIter(const node_pointer ptr) : elem_(ptr){};
+  BDIter(const link_pointer ptr) : elem_(ptr){};
   BDIter(const BDIter& other) : elem_(other.elem_){};
+  template <typename U, typename = typename ns::enable_if<
+                            std::is_same<const U, T>::value>::type>
+  BDIter(const BDIter<U, Node>& other) : elem_(other.base()){};
   ~BDIter(){};
 
   BDIter& operator=(const BDIter& other) {
@@ -138,37 +143,43 @@ class BDIter {  // universal bidirectional iterator for the rb tree, map, set, m
   typename ns::conditional<ns::is_const<T>::value, const_reference,
                             reference>::type
   operator*() const {
-    return (elem_->value);
+    return (static_cast<node_pointer>(elem_)->value);
   }
 
   bool operator==(const BDIter& other) const { return (elem_ == other.elem_); };
   bool operator!=(const BDIter& other) const { return (elem_ != other.elem_); };
 
-  node_pointer operator->() const { return elem_; };
+  node_pointer operator->() const { return static_cast<node_pointer>(elem_); };
+
+  // The raw link, which for the tree may be its header (end()).
+  link_pointer base() const { return elem_; };
+
   BDIter& operator++() {
-    if (elem_->forward() != nullptr) elem_ = elem_->forward();
+    link_pointer next = elem_->forward();
+    if (next != nullptr) elem_ = next;
     return (*this);
   }
 
   BDIter& operator--() {
-    if (elem_->back() != nullptr) elem_ = elem_->back();
+    link_pointer prev = elem_->back();
+    if (prev != nullptr) elem_ = prev;
     return (*this);
   }
 
   BDIter operator++(int) {
     BDIter temp = *this;
-    if (elem_->forward() != nullptr) ++(*this);
+    ++(*this);
     return temp;
   }
 
   BDIter operator--(int) {
     BDIter temp = *this;
-    if (elem_->back() != nullptr) --(*this);
+    --(*this);
     return (temp);
   }
 
  private:
-  node_pointer elem_;
+  link_pointer elem_;
 };
 
 template <typename T>
@@ -1,16 +1,20 @@
 #ifndef LIST_H_
 #define LIST_H_
 
+#include <memory>
+
 #include "allocator.h"
 #include "compare.h"
+#include "iterator.h"
 #include "node.h"
 #include "utils.h"
+#include "vector.h"
 
 #define SIZE 64  // architecture defined
 
 namespace ns {
 
-template <typename T, typename Allocator = ns::LinearAllocator<T>>
+template <typename T, typename Allocator = ns::allocator<T>>
 class list {
  public:
   using node_type = ns::ListNode<T>;
@@ -23,57 +27,81 @@ class list {
   using const_iter = ns::BDIter<const T, node_type>;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
-  using allocator_type = typename Allocator::template rebind<node_type>::other;
+  using allocator_type = Allocator;
 
   list(const allocator_type& alloc = allocator_type(),
        const value_type& val = value_type())
       : alloc_(alloc), size_(0), head_(nullptr) {
-    head_ = alloc_.allocate(1);
-    alloc_.construct(head_, node_type(val));
-    head_->prev = head_;
-    head_->next = head_;
+    NewHead(val);
   }
 
-  list(size_type num, const value_type& val = value_type()) : list() {
+  list(size_type num, const value_type& val = value_type(),
+       const allocator_type& alloc = allocator_type())
+      : list(alloc) {
     for (size_type i = 0; i < num; ++i) push_back(val);
   }
 
-  list(const std::initializer_list<T>& items) : list() {
+  list(const std::initializer_list<T>& items,
+       const allocator_type& alloc = allocator_type())
+      : list(alloc) {
     for (const value_type& item : items) push_back(item);
   }
 
-  list(const list& l) : list() {
-    const_iter first = l.cbegin();
-    const_iter last = l.cend();
-    while (first != last) {
-      push_back(*first);
-      ++first;
-    }
+  list(const list& l)
+      : list(l, node_traits::select_on_container_copy_construction(l.alloc_)) {
   }
 
-  list(list&& l) : list() { swap(l); }
+  list(const list& l, const allocator_type& alloc) : list(alloc) {
+    CopyFrom(l);
+  }
+
+  list(list&& l) : list(NodeAllocTag(), l.alloc_) { Exchange(l); }
+
+  list(list&& l, const allocator_type& alloc) : list(alloc) {
+    if (alloc_ == l.alloc_) {
+      Exchange(l);
+    } else {
+      CopyFrom(l);
+      l.clear();
+    }
+  }
 
   ~list() {
     clear();
-    alloc_.destroy(head_);
-    alloc_.deallocate(head_, 1);
+    DelHead();
   }
 
   list& operator=(const list& l) {
-    if (this != &l) {
-      list temp(l);
-      swap(temp);
+    if (this == &l) return (*this);
+    clear();
+    if constexpr (node_traits::propagate_on_container_copy_assignment::value) {
+      if (alloc_ != l.alloc_) {
+        DelHead();
+        alloc_ = l.alloc_;
+        NewHead(value_type());
+      }
     }
+    CopyFrom(l);
     return (*this);
   }
 
   list& operator=(list&& l) {
-    if (this != &l) {
-      swap(l);
+    if (this == &l) return (*this);
+    clear();
+    if constexpr (node_traits::propagate_on_container_move_assignment::value) {
+      Exchange(l);
+      std::swap(alloc_, l.alloc_);
+    } else if (alloc_ == l.alloc_) {
+      Exchange(l);
+    } else {
+      CopyFrom(l);
+      l.clear();
     }
     return (*this);
   }
 
+  allocator_type get_allocator() const { return allocator_type(alloc_); }
+
   iter begin() const { return (iter(head_->next)); }
   iter end() const { return (iter(head_)); }
 
@@ -142,8 +170,9 @@ class list {
   void pop_front() { erase(begin()); };
 
   void swap(list& other) {
-    std::swap(head_, other.head_);
-    std::swap(size_, other.size_);
+    if constexpr (node_traits::propagate_on_container_swap::value)
+      std::swap(alloc_, other.alloc_);
+    Exchange(other);
   }
 
   void reverse() {
@@ -195,11 +224,14 @@ class list {
 
   void sort() {
     if (empty()) return;
-    list item[SIZE] = {};
+    ns::vector<list> item;
+    item.reserve(SIZE);
+    for (int i = 0; i < SIZE; ++i)
+      item.emplace_back(list(NodeAllocTag(), alloc_));
     int pow = GetPow();
-    GetArray(item);
+    GetArray(item.data());
     for (int i = 1; i <= pow; ++i) item[i].merge(item[i - 1]);
-    swap(item[pow]);
+    Exchange(item[pow]);
   }
 
   template <typename... Args>
@@ -233,10 +265,21 @@ class list {
   }
 
  private:
-  allocator_type alloc_;
+  using node_allocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<node_type>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  node_allocator alloc_;
   size_type size_;
   node_pointer head_;
 
+  // Builds an empty list that shares alloc.
+  struct NodeAllocTag {};
+  list(NodeAllocTag, const node_allocator& alloc)
+      : alloc_(alloc), size_(0), head_(nullptr) {
+    NewHead(value_type());
+  }
+
   void Link(iter pos, iter first, iter last) {
     if (pos != first && pos != last) {
       node_pointer temp = pos->prev;
@@ -250,6 +293,29 @@ class list {
     }
   }
 
+  void NewHead(const value_type& val) {
+    head_ = alloc_.allocate(1);
+    alloc_.construct(head_, node_type(val));
+    head_->prev = head_;
+    head_->next = head_;
+  }
+
+  void DelHead() {
+    alloc_.destroy(head_);
+    alloc_.deallocate(head_, 1);
+  }
+
+  void Exchange(list& other) {
+    std::swap(head_, other.head_);
+    std::swap(size_, other.size_);
+  }
+
+  void CopyFrom(const list& l) {
+    for (const_iter first = l.cbegin(), last = l.cend(); first != last;
+         ++first)
+      push_back(*first);
+  }
+
   void GetSize() {
     size_type n = 0;
     for (const_iter it = cbegin(), last = cend(); it != last; ++it) ++n;
@@ -1,6 +1,7 @@
 #ifndef MAP_H_
 #define MAP_H_
 
+#include <tuple>
 #include <vector>
 
 #include "node.h"
@@ -10,7 +11,7 @@
 namespace ns {
 
 template <typename Key, typename T, typename Compare = std::less<Key>,
-          typename Allocator = ns::LinearAllocator<std::pair<Key, T>>>
+          typename Allocator = ns::allocator<std::pair<Key, T>>>
 class map {
  public:
   using key_type = Key;
@@ -20,7 +21,7 @@ class map {
   using const_pointer = const value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
-  using node_type = ns::RBTnode<value_type>;
+  using node_type = ns::RBTnode<value_type, ns::node_links_t<Allocator>>;
   using node_pointer = node_type*;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
@@ -41,9 +42,49 @@ class map {
     bool operator()(const_reference x, const_reference y) const {
       return comp_(x.first, y.first);
     }
+
+    // Key against element, for lookups without a temporary pair.
+    bool operator()(const key_type& x, const_reference y) const {
+      return comp_(x, y.first);
+    }
+    bool operator()(const_reference x, const key_type& y) const {
+      return comp_(x.first, y);
+    }
+
+    template <typename K, typename C = compare_type,
+              typename = std::enable_if_t<ns::is_transparent<C>::value>>
+    bool operator()(const K& x, const_reference y) const {
+      return comp_(x, y.first);
+    }
+    template <typename K, typename C = compare_type,
+              typename = std::enable_if_t<ns::is_transparent<C>::value>>
+    bool operator()(const_reference x, const K& y) const {
+      return comp_(x.first, y);
+    }
+
+    // Three-way forms, present when compare_type has compare().
+    template <typename C = compare_type,
+              typename = std::enable_if_t<
+                  ns::has_three_way<C, key_type, key_type>::value>>
+    int compare(const_reference x, const_reference y) const {
+      return comp_.compare(x.first, y.first);
+    }
+
+    template <typename K,
+              typename = std::enable_if_t<
+                  ns::has_three_way<compare_type, K, key_type>::value &&
+                  (std::is_same<K, key_type>::value ||
+                   ns::is_transparent<compare_type>::value)>>
+    int compare(const K& x, const_reference y) const {
+      return comp_.compare(x, y.first);
+    }
   };
 
   using tree_type = ns::RBTree<value_type, value_compare, allocator_type>;
+  using node_handle =
+      ns::NodeHandle<typename tree_type::node_type,
+                     typename tree_type::allocator_type, true>;
+  using insert_return_type = ns::InsertReturn<iter, node_handle>;
 
   map(const allocator_type& alloc = allocator_type(),
       const value_compare& comp = compare_type())
@@ -60,13 +101,40 @@ class map {
     for (; first != last; first++) insert(*first);
   };
 
-  map(const map& m) : tree_(m.tree_){};
+  // Linear-time construction from input sorted by key; repeated keys are
+  // dropped.
+  template <typename InputIt>
+  map(ns::sorted_unique_t, InputIt first, InputIt last,
+      const allocator_type& alloc = allocator_type(),
+      const value_compare& comp = compare_type())
+      : tree_(alloc, comp) {
+    tree_.assign_sorted(first, last, true);
+  };
+
+  map(ns::sorted_unique_t, std::initializer_list<value_type> list,
+      const allocator_type& alloc = allocator_type(),
+      const value_compare& comp = compare_type())
+      : map(ns::sorted_unique, list.begin(), list.end(), alloc, comp){};
 
-  map(map&& m) : tree_() {
-    if (m.empty()) return;
-    swap(m);
+  template <typename InputIt>
+  static map from_sorted(InputIt first, InputIt last,
+                         const allocator_type& alloc = allocator_type(),
+                         const value_compare& comp = compare_type()) {
+    return (map(ns::sorted_unique, first, last, alloc, comp));
   }
 
+  map(const map& m) : tree_(m.tree_){};
+
+  map(const map& m, const allocator_type& alloc) : tree_(m.tree_, alloc){};
+
+  // Copies a large map on several threads; see ns::parallel_t.
+  map(ns::parallel_t, const map& m) : tree_(ns::parallel, m.tree_){};
+
+  map(map&& m) : tree_(std::move(m.tree_)){};
+
+  map(map&& m, const allocator_type& alloc)
+      : tree_(std::move(m.tree_), alloc){};
+
   ~map(){};
 
   map& operator=(const map& m) {
@@ -76,22 +144,26 @@ class map {
     return (*this);
   };
   map& operator=(map&& m) {
-    if (this == &m) return *this;
-    clear();
-    swap(m);
+    tree_ = std::move(m.tree_);
     return (*this);
   };
 
-  iter begin() const { return (size() ? tree_.start() : nullptr); };
-  const_iter cbegin() const {
-    return (size() ? const_iter(tree_.cstart()) : nullptr);
-  };
+  allocator_type get_allocator() const {
+    return (allocator_type(tree_.get_allocator()));
+  }
 
-  iter end() const { return (size() ? tree_.edge() : nullptr); };
+  iter begin() const { return (tree_.begin()); };
+  const_iter cbegin() const { return (tree_.cbegin()); };
 
-  const_iter cend() const {
-    return (size() ? const_iter(tree_.cedge()) : nullptr);
-  };
+  iter end() const { return (tree_.end()); };
+
+  const_iter cend() const { return (tree_.cend()); };
+
+  // Calls f(element) on every element in order and returns f.
+  template <typename F>
+  F for_each(F f) const {
+    return (tree_.for_each(std::move(f)));
+  }
 
   bool empty() const { return (!size()); };
 
@@ -99,27 +171,86 @@ class map {
 
   size_type max_size() const { return (tree_.max_size()); };
 
-  mapped_type& at(const key_type& key) {
-    if (tree_.find(std::make_pair(key, mapped_type())).second != true)
-      throw std::out_of_range("there is no this key in the map");
-    return (tree_.find(std::make_pair(key, mapped_type())).first->value.second);
-  };
+  mapped_type& at(const key_type& key) { return (At(key)); };
+
+  const mapped_type& at(const key_type& key) const { return (At(key)); };
+
+  template <typename K, typename C = compare_type,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  mapped_type& at(const K& key) {
+    return (At(key));
+  }
+
+  template <typename K, typename C = compare_type,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  const mapped_type& at(const K& key) const {
+    return (At(key));
+  }
 
+  // Looks the key up and value-initializes a mapped value only if missing.
   mapped_type& operator[](const key_type& key) {
-    return ((insert(std::make_pair(key, mapped_type()))).first->value.second);
+    return (try_emplace(key).first->value.second);
+  };
+
+  mapped_type& operator[](key_type&& key) {
+    return (try_emplace(std::move(key)).first->value.second);
   };
 
   std::pair<iter, bool> insert(const_reference val) {
     return (tree_.insert(val));
   };
 
+  std::pair<iter, bool> insert(value_type&& val) {
+    return (tree_.insert(std::move(val)));
+  };
+
+  // Builds the element in place; it is destroyed again if the key is taken.
+  template <typename... Args>
+  std::pair<iter, bool> emplace(Args&&... args) {
+    return (tree_.emplace(std::forward<Args>(args)...));
+  };
+
+  // Constructs nothing when the key is present; otherwise builds the
+  // element once, from key and mapped_type(args...).
+  template <typename... Args>
+  std::pair<iter, bool> try_emplace(const key_type& key, Args&&... args) {
+    return (tree_.try_emplace(key, std::piecewise_construct,
+                              std::forward_as_tuple(key),
+                              std::forward_as_tuple(
+                                  std::forward<Args>(args)...)));
+  };
+
+  template <typename... Args>
+  std::pair<iter, bool> try_emplace(key_type&& key, Args&&... args) {
+    return (tree_.try_emplace(key, std::piecewise_construct,
+                              std::forward_as_tuple(std::move(key)),
+                              std::forward_as_tuple(
+                                  std::forward<Args>(args)...)));
+  };
+
+  // Amortized O(1) when val belongs right before or after hint.
+  iter insert(const_iter hint, const_reference val) {
+    return (tree_.insert(hint, val));
+  }
+
+  iter insert(const_iter hint, value_type&& val) {
+    return (tree_.insert(hint, std::move(val)));
+  }
+
+  template <typename... Args>
+  iter emplace_hint(const_iter hint, Args&&... args) {
+    return (tree_.emplace_hint(hint, std::forward<Args>(args)...));
+  }
+
   std::pair<iter, bool> insert(const key_type& key, const mapped_type& obj) {
     return (tree_.insert(std::make_pair(key, obj)));
   };
 
   std::pair<iter, bool> insert_or_assign(const key_type& key,
                                          const mapped_type& obj) {
-    return (tree_.insert_or_assign(std::make_pair(key, obj)));
+    std::pair<iter, bool> result = tree_.try_emplace(key, key, obj);
+    if (!result.second) result.first->value.second = obj;
+    return (result);
   };
 
   template <typename... Args>
@@ -137,28 +268,120 @@ class map {
     }
   };
 
-  void merge(map& other) {
-    iter first = other.begin();
-    const iter last = other.end();
-    for (; first != last; ++first) insert(*first);
-    insert(*last);
-    other.clear();
-  };
+  iter erase(const_iter first, const_iter last) {
+    tree_.erase(first, last);
+    return (iter(last.base()));
+  }
+
+  size_type erase(const key_type& key) {
+    std::pair<iter, bool> found = tree_.find(key);
+    if (!found.second) return 0;
+    tree_.erase(found.first);
+    return (1);
+  }
+
+  // Returns how many elements were erased.
+  template <typename Pred>
+  size_type erase_if(Pred pred) {
+    return (tree_.erase_if(pred));
+  }
+
+  // Unlinks the element and hands its node over, without freeing it. An
+  // absent key or end() gives an empty handle.
+  node_handle extract(const_iter pos) {
+    return (tree_.template extract<node_handle>(pos));
+  }
+
+  node_handle extract(const key_type& key) {
+    return (extract(tree_.find(key).first));
+  }
+
+  // Relinks the node of handle; when the key is already present the handle
+  // comes back in the result.
+  insert_return_type insert(node_handle&& handle) {
+    std::pair<iter, bool> result = tree_.insert_node(handle, true);
+    return (insert_return_type{result.first, result.second, std::move(handle)});
+  }
+
+  // Moves the nodes of other over; other is left empty. Keys present in
+  // both keep this map's value.
+  void merge(map& other) { tree_.unite(other.tree_); };
+
+  // Keeps only the keys also in other; other is left empty.
+  void intersect(map& other) { tree_.intersect(other.tree_); };
+
+  // Drops the keys found in other; other is left empty.
+  void subtract(map& other) { tree_.subtract(other.tree_); };
+
+  // Same, on several threads for large maps; see ns::parallel_t.
+  void merge(map& other, ns::parallel_t) {
+    tree_.unite(other.tree_, ns::parallel);
+  }
+
+  void intersect(map& other, ns::parallel_t) {
+    tree_.intersect(other.tree_, ns::parallel);
+  }
+
+  void subtract(map& other, ns::parallel_t) {
+    tree_.subtract(other.tree_, ns::parallel);
+  }
 
   void clear() { tree_.clear(); };
 
   bool IsBalanced() { return (tree_.is_balanced()); };
 
-  bool contains(const key_type& key) {
-    return (tree_.find(std::make_pair(key, mapped_type())).second);
+  iter find(const key_type& key) const { return (tree_.find(key).first); };
+
+  bool contains(const key_type& key) const { return (tree_.find(key).second); };
+
+  size_type count(const key_type& key) const {
+    return (tree_.find(key).second);
   };
 
+  // Batched lookups: one iterator, or one bool, per key is written to out.
+  template <typename Keys, typename OutIt>
+  OutIt find_batch(const Keys& keys, OutIt out) const {
+    return (tree_.find_batch(std::begin(keys), std::end(keys), out));
+  }
+
+  template <typename Keys, typename OutIt>
+  OutIt contains_batch(const Keys& keys, OutIt out) const {
+    return (tree_.contains_batch(std::begin(keys), std::end(keys), out));
+  }
+
+  // Heterogeneous lookups, for transparent comparators only.
+  template <typename K, typename C = compare_type,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  iter find(const K& key) const {
+    return (tree_.find(key).first);
+  }
+
+  template <typename K, typename C = compare_type,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  bool contains(const K& key) const {
+    return (tree_.find(key).second);
+  }
+
+  template <typename K, typename C = compare_type,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  size_type count(const K& key) const {
+    return (tree_.find(key).second);
+  }
+
   void swap(map& m) { tree_.swap(m.tree_); };
 
   void print() { tree_.print(); };
 
  private:
   tree_type tree_;
+
+  template <typename K>
+  mapped_type& At(const K& key) const {
+    std::pair<iter, bool> found = tree_.find(key);
+    if (!found.second)
+      throw std::out_of_range("there is no this key in the map");
+    return (found.first->value.second);
+  }
 };
 
 }  // namespace ns
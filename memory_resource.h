@@ -0,0 +1,390 @@
+#ifndef MEMORY_RESOURCE_H_
+#define MEMORY_RESOURCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "allocator.h"
+#include "list.h"
+#include "map.h"
+#include "multiset.h"
+#include "pool.h"
+#include "set.h"
+#include "vector.h"
+
+namespace ns {
+namespace pmr {
+
+// Runtime-polymorphic source of memory. Containers allocating through a
+// polymorphic_allocator share one type whatever resource backs them.
+class memory_resource {
+ public:
+  static constexpr std::size_t kMaxAlign = alignof(std::max_align_t);
+
+  virtual ~memory_resource() {}
+
+  void* allocate(std::size_t bytes, std::size_t align = kMaxAlign) {
+    return do_allocate(bytes, align);
+  }
+
+  void deallocate(void* ptr, std::size_t bytes,
+                  std::size_t align = kMaxAlign) {
+    do_deallocate(ptr, bytes, align);
+  }
+
+  bool is_equal(const memory_resource& other) const noexcept {
+    return do_is_equal(other);
+  }
+
+ private:
+  virtual void* do_allocate(std::size_t bytes, std::size_t align) = 0;
+  virtual void do_deallocate(void* ptr, std::size_t bytes,
+                             std::size_t align) = 0;
+  virtual bool do_is_equal(const memory_resource& other) const noexcept = 0;
+};
+
+inline bool operator==(const memory_resource& lhs,
+                       const memory_resource& rhs) {
+  return &lhs == &rhs || lhs.is_equal(rhs);
+}
+
+inline bool operator!=(const memory_resource& lhs,
+                       const memory_resource& rhs) {
+  return !(lhs == rhs);
+}
+
+// Plain ::operator new / ::operator delete.
+class new_delete_resource_type : public memory_resource {
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    if (align > kMaxAlign)
+      return ::operator new(bytes, std::align_val_t(align));
+    return ::operator new(bytes);
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes,
+                     std::size_t align) override {
+    (void)bytes;
+    if (align > kMaxAlign)
+      ::operator delete(ptr, std::align_val_t(align));
+    else
+      ::operator delete(ptr);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+inline memory_resource* new_delete_resource() noexcept {
+  static new_delete_resource_type resource;
+  return &resource;
+}
+
+namespace detail {
+inline std::atomic<memory_resource*>& default_resource() noexcept {
+  static std::atomic<memory_resource*> resource(new_delete_resource());
+  return resource;
+}
+}  // namespace detail
+
+inline memory_resource* get_default_resource() noexcept {
+  return detail::default_resource().load();
+}
+
+// Returns the previous default; nullptr restores new_delete_resource().
+inline memory_resource* set_default_resource(memory_resource* r) noexcept {
+  if (r == nullptr) r = new_delete_resource();
+  return detail::default_resource().exchange(r);
+}
+
+// Bump allocation from a LinearArena. deallocate() is a no-op; memory comes
+// back all at once on release() or destruction.
+class monotonic_buffer_resource : public memory_resource {
+ public:
+  monotonic_buffer_resource() {}
+  explicit monotonic_buffer_resource(std::size_t chunk_size)
+      : arena_(chunk_size) {}
+  monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+  monotonic_buffer_resource& operator=(const monotonic_buffer_resource&) =
+      delete;
+
+  void release() { arena_.release(); }
+
+ private:
+  LinearArena arena_;
+
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    return arena_.allocate(bytes ? bytes : 1, align);
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes,
+                     std::size_t align) override {
+    (void)ptr;
+    (void)bytes;
+    (void)align;
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+struct pool_options {
+  std::size_t max_blocks_per_chunk = NodePool::kDefaultSlabBlocks;
+  std::size_t largest_required_pool_block = 512;
+};
+
+// One NodePool per block size, in steps of the maximum alignment, created
+// on first use. Larger or over-aligned requests go to new_delete_resource().
+// Not thread safe.
+class unsynchronized_pool_resource : public memory_resource {
+ public:
+  unsynchronized_pool_resource()
+      : unsynchronized_pool_resource(pool_options()) {}
+  explicit unsynchronized_pool_resource(const pool_options& opts)
+      : opts_(opts),
+        pool_count_(NodePool::block_size_for(opts.largest_required_pool_block) /
+                    kMaxAlign),
+        pools_(new std::unique_ptr<NodePool>[pool_count_]) {
+    opts_.largest_required_pool_block = pool_count_ * kMaxAlign;
+  }
+  unsynchronized_pool_resource(const unsynchronized_pool_resource&) = delete;
+  unsynchronized_pool_resource& operator=(const unsynchronized_pool_resource&) =
+      delete;
+
+  // Frees every pool, including blocks still held by containers.
+  void release() {
+    for (std::size_t i = 0; i < pool_count_; ++i) pools_[i].reset();
+  }
+
+  pool_options options() const { return opts_; }
+
+ private:
+  pool_options opts_;
+  std::size_t pool_count_;
+  std::unique_ptr<std::unique_ptr<NodePool>[]> pools_;
+
+  bool Pooled(std::size_t bytes, std::size_t align) const {
+    return bytes <= opts_.largest_required_pool_block && align <= kMaxAlign;
+  }
+
+  NodePool& Pool(std::size_t bytes) {
+    std::size_t idx = bytes ? (bytes - 1) / kMaxAlign : 0;
+    if (!pools_[idx])
+      pools_[idx].reset(
+          new NodePool((idx + 1) * kMaxAlign, opts_.max_blocks_per_chunk));
+    return *pools_[idx];
+  }
+
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    if (!Pooled(bytes, align))
+      return new_delete_resource()->allocate(bytes, align);
+    return Pool(bytes).allocate();
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes,
+                     std::size_t align) override {
+    if (!Pooled(bytes, align))
+      return new_delete_resource()->deallocate(ptr, bytes, align);
+    Pool(bytes).deallocate(ptr);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// unsynchronized_pool_resource behind a mutex.
+class synchronized_pool_resource : public memory_resource {
+ public:
+  synchronized_pool_resource() {}
+  explicit synchronized_pool_resource(const pool_options& opts)
+      : pools_(opts) {}
+  synchronized_pool_resource(const synchronized_pool_resource&) = delete;
+  synchronized_pool_resource& operator=(const synchronized_pool_resource&) =
+      delete;
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pools_.release();
+  }
+
+  pool_options options() const { return pools_.options(); }
+
+ private:
+  std::mutex mutex_;
+  unsynchronized_pool_resource pools_;
+
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pools_.allocate(bytes, align);
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes,
+                     std::size_t align) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pools_.deallocate(ptr, bytes, align);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Allocator forwarding to a memory_resource. Like std::pmr, it never
+// propagates, copies made by container copy construction get the default
+// resource, and elements that take a compatible allocator as their last
+// constructor argument are handed one on construction; pairs pass it on to
+// both members. ns::list copies its values into the nodes and is left out.
+template <typename T>
+class polymorphic_allocator {
+  template <typename U>
+  struct IsPair : std::false_type {};
+  template <typename T1, typename T2>
+  struct IsPair<std::pair<T1, T2>> : std::true_type {};
+
+ public:
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  polymorphic_allocator() noexcept : resource_(get_default_resource()) {}
+  polymorphic_allocator(memory_resource* resource) : resource_(resource) {}
+  polymorphic_allocator(const polymorphic_allocator&) = default;
+  template <typename U>
+  polymorphic_allocator(const polymorphic_allocator<U>& other) noexcept
+      : resource_(other.resource()) {}
+
+  polymorphic_allocator& operator=(const polymorphic_allocator&) = delete;
+
+  pointer allocate(size_type n) {
+    if (n > max_size()) throw std::bad_array_new_length();
+    return static_cast<pointer>(
+        resource_->allocate(n * sizeof(value_type), alignof(value_type)));
+  }
+
+  void deallocate(void* ptr, size_type n) {
+    resource_->deallocate(ptr, n * sizeof(value_type), alignof(value_type));
+  }
+
+  template <typename U, typename... Args>
+  std::enable_if_t<!IsPair<U>::value> construct(U* ptr, Args&&... args) {
+    if constexpr (std::uses_allocator<U, polymorphic_allocator>::value &&
+                  std::is_constructible<U, Args...,
+                                        const polymorphic_allocator&>::value)
+      ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)..., *this);
+    else
+      ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename T1, typename T2, typename... Args1, typename... Args2>
+  void construct(std::pair<T1, T2>* ptr, std::piecewise_construct_t,
+                 std::tuple<Args1...> first, std::tuple<Args2...> second) {
+    ::new (static_cast<void*>(ptr))
+        std::pair<T1, T2>(std::piecewise_construct,
+                          WithAllocator<T1>(std::move(first)),
+                          WithAllocator<T2>(std::move(second)));
+  }
+
+  template <typename T1, typename T2>
+  void construct(std::pair<T1, T2>* ptr) {
+    construct(ptr, std::piecewise_construct, std::tuple<>(), std::tuple<>());
+  }
+
+  template <typename T1, typename T2, typename U, typename V>
+  void construct(std::pair<T1, T2>* ptr, U&& first, V&& second) {
+    construct(ptr, std::piecewise_construct,
+              std::forward_as_tuple(std::forward<U>(first)),
+              std::forward_as_tuple(std::forward<V>(second)));
+  }
+
+  template <typename T1, typename T2, typename U, typename V>
+  void construct(std::pair<T1, T2>* ptr, const std::pair<U, V>& other) {
+    construct(ptr, std::piecewise_construct,
+              std::forward_as_tuple(other.first),
+              std::forward_as_tuple(other.second));
+  }
+
+  template <typename T1, typename T2, typename U, typename V>
+  void construct(std::pair<T1, T2>* ptr, std::pair<U, V>&& other) {
+    construct(ptr, std::piecewise_construct,
+              std::forward_as_tuple(std::forward<U>(other.first)),
+              std::forward_as_tuple(std::forward<V>(other.second)));
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  size_type max_size() const noexcept {
+    return std::numeric_limits<size_type>::max() / sizeof(value_type);
+  }
+
+  polymorphic_allocator select_on_container_copy_construction() const {
+    return polymorphic_allocator();
+  }
+
+  memory_resource* resource() const { return resource_; }
+
+ private:
+  // Constructor arguments for a pair member, with the allocator appended
+  // when the member takes it.
+  template <typename U, typename... Args>
+  auto WithAllocator(std::tuple<Args...>&& args) const {
+    if constexpr (std::uses_allocator<U, polymorphic_allocator>::value &&
+                  std::is_constructible<U, Args...,
+                                        const polymorphic_allocator&>::value)
+      return std::tuple_cat(std::move(args),
+                            std::tuple<const polymorphic_allocator&>(*this));
+    else
+      return std::move(args);
+  }
+
+  memory_resource* resource_;
+};
+
+template <typename T, typename U>
+bool operator==(const polymorphic_allocator<T>& lhs,
+                const polymorphic_allocator<U>& rhs) {
+  return *lhs.resource() == *rhs.resource();
+}
+
+template <typename T, typename U>
+bool operator!=(const polymorphic_allocator<T>& lhs,
+                const polymorphic_allocator<U>& rhs) {
+  return !(lhs == rhs);
+}
+
+template <typename T>
+using vector = ns::vector<T, polymorphic_allocator<T>>;
+
+template <typename T>
+using list = ns::list<T, polymorphic_allocator<T>>;
+
+template <typename Key, typename Compare = std::less<Key>>
+using set = ns::set<Key, Compare, polymorphic_allocator<Key>>;
+
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using map =
+    ns::map<Key, T, Compare, polymorphic_allocator<std::pair<Key, T>>>;
+
+template <typename Key, typename Compare = std::less<Key>>
+using multiset = ns::multiset<Key, Compare, polymorphic_allocator<Key>>;
+
+}  // namespace pmr
+}  // namespace ns
+
+#endif  // MEMORY_RESOURCE_H_
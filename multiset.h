@@ -7,8 +7,11 @@
 
 namespace ns {
 
-template <typename Key, typename Compare = std::less_equal<Key>,
-          typename Allocator = ns::LinearAllocator<Key>>
+// TreePolicy = ns::CountedTree keeps subtree sizes: count() becomes
+// O(log n) and nth() and rank() are available.
+template <typename Key, typename Compare = std::less<Key>,
+          typename Allocator = ns::allocator<Key>,
+          typename TreePolicy = ns::PlainTree>
 class multiset {
  public:
   using compare_type = Compare;
@@ -18,30 +21,68 @@ class multiset {
   using const_pointer = const value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
-  using node_type = ns::RBTnode<value_type>;
+  using node_type = ns::RBTnode<value_type, ns::node_links_t<Allocator>>;
   using node_pointer = node_type*;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
   using allocator_type = Allocator;
   using tree_type =
-      ns::RBTree<value_type, std::less<value_type>, allocator_type>;
+      ns::RBTree<value_type, compare_type, allocator_type, TreePolicy>;
+  using node_handle =
+      ns::NodeHandle<typename tree_type::node_type,
+                     typename tree_type::allocator_type>;
   using iter = ns::BDIter<value_type, node_type>;
   using const_iter = ns::BDIter<const value_type, node_type>;
 
-  multiset(const allocator_type& alloc = allocator_type()) : tree_(alloc){};
+  multiset(const allocator_type& alloc = allocator_type(),
+           const compare_type& comp = compare_type())
+      : tree_(alloc, comp){};
 
   multiset(std::initializer_list<value_type> list,
-           const allocator_type& alloc = allocator_type())
-      : tree_(alloc) {
+           const allocator_type& alloc = allocator_type(),
+           const compare_type& comp = compare_type())
+      : tree_(alloc, comp) {
     for (const value_type& val : list) {
       tree_.insert_all(val);
     }
   };
 
+  // Linear-time construction from input sorted by comp.
+  template <typename InputIt>
+  multiset(ns::sorted_equivalent_t, InputIt first, InputIt last,
+           const allocator_type& alloc = allocator_type(),
+           const compare_type& comp = compare_type())
+      : tree_(alloc, comp) {
+    tree_.assign_sorted(first, last, false);
+  };
+
+  multiset(ns::sorted_equivalent_t, std::initializer_list<value_type> list,
+           const allocator_type& alloc = allocator_type(),
+           const compare_type& comp = compare_type())
+      : multiset(ns::sorted_equivalent, list.begin(), list.end(), alloc,
+                 comp){};
+
+  template <typename InputIt>
+  static multiset from_sorted(InputIt first, InputIt last,
+                              const allocator_type& alloc = allocator_type(),
+                              const compare_type& comp = compare_type()) {
+    return (multiset(ns::sorted_equivalent, first, last, alloc, comp));
+  }
+
   multiset(const multiset& other) : tree_(other.tree_){};
 
+  multiset(const multiset& other, const allocator_type& alloc)
+      : tree_(other.tree_, alloc){};
+
+  // Copies a large multiset on several threads; see ns::parallel_t.
+  multiset(ns::parallel_t, const multiset& other)
+      : tree_(ns::parallel, other.tree_){};
+
   multiset(multiset&& other) : tree_(std::move(other.tree_)){};
 
+  multiset(multiset&& other, const allocator_type& alloc)
+      : tree_(std::move(other.tree_), alloc){};
+
   ~multiset(){};
 
   multiset& operator=(const multiset& other) {
@@ -56,28 +97,34 @@ class multiset {
     return *this;
   };
 
+  allocator_type get_allocator() const {
+    return (allocator_type(tree_.get_allocator()));
+  }
+
   size_type size() const { return (tree_.size()); };
 
   size_type max_size() const {
     return (std::numeric_limits<size_type>::max() / (20 * sizeof(value_type)));
   };
 
-  iter begin() { return (size() ? iter(tree_.start()) : nullptr); };
+  iter begin() { return (tree_.begin()); };
 
-  const_iter begin() const {
-    return (size() ? const_iter(tree_.cstart()) : nullptr);
-  };
+  const_iter begin() const { return (tree_.cbegin()); };
 
   const_iter cbegin() const { return begin(); }
 
-  iter end() { return (size() ? iter(tree_.edge()) : nullptr); };
+  iter end() { return (tree_.end()); };
 
-  const_iter end() const {
-    return (size() ? const_iter(tree_.cedge()) : nullptr);
-  };
+  const_iter end() const { return (tree_.cend()); };
 
   const_iter cend() const { return end(); }
 
+  // Calls f(key) on every element in order and returns f.
+  template <typename F>
+  F for_each(F f) const {
+    return (tree_.for_each(std::move(f)));
+  }
+
   bool empty() const { return (!size()); };
 
   iter insert(const_reference& val) {
@@ -85,6 +132,29 @@ class multiset {
     return result.first;
   }
 
+  iter insert(value_type&& val) {
+    return (tree_.insert_all(std::move(val)).first);
+  }
+
+  template <typename... Args>
+  iter emplace(Args&&... args) {
+    return (tree_.emplace_all(std::forward<Args>(args)...));
+  }
+
+  // Amortized O(1) when val belongs right before or after hint.
+  iter insert(const_iter hint, const_reference val) {
+    return (tree_.insert_all(hint, val));
+  }
+
+  iter insert(const_iter hint, value_type&& val) {
+    return (tree_.insert_all(hint, std::move(val)));
+  }
+
+  template <typename... Args>
+  iter emplace_hint(const_iter hint, Args&&... args) {
+    return (tree_.emplace_hint_all(hint, std::forward<Args>(args)...));
+  }
+
   template <typename... Args>
   ns::vector<std::pair<iter, bool>> insert_many(Args&&... args) {
     ns::vector<std::pair<iter, bool>> vector;
@@ -100,25 +170,54 @@ class multiset {
     }
   };
 
+  iter erase(const_iter first, const_iter last) {
+    tree_.erase(first, last);
+    return (iter(last.base()));
+  }
+
+  // Erases every element equivalent to key.
+  size_type erase(const key_type& key) {
+    std::pair<iter, iter> range = tree_.equal_range(key);
+    return (tree_.erase(range.first, range.second));
+  }
+
+  // Returns how many elements were erased.
+  template <typename Pred>
+  size_type erase_if(Pred pred) {
+    return (tree_.erase_if(pred));
+  }
+
   void clear() { tree_.clear(); };
 
+  // Unlinks the element and hands its node over, without freeing it. An
+  // absent key or end() gives an empty handle.
+  node_handle extract(const_iter pos) {
+    return (tree_.template extract<node_handle>(pos));
+  }
+
+  node_handle extract(const key_type& key) { return (extract(find(key))); }
+
+  // Relinks the node of handle after any equivalent elements; an empty
+  // handle gives end().
+  iter insert(node_handle&& handle) {
+    return (tree_.insert_node(handle, false).first);
+  }
+
   bool IsBalanced() { return (tree_.is_balanced()); };
 
   void swap(multiset& other) { tree_.swap(other.tree_); };
 
   void print() { tree_.print_mult(); };
 
-  size_type count(const key_type& key) {
-    iter it = lower_bound(key);
-    iter last = upper_bound(key);
-    size_type n = 0;
+  size_type count(const key_type& key) const { return (tree_.count(key)); }
 
-    while (it != last) {
-      ++n;
-      ++it;
-    }
+  // Order statistics; need TreePolicy = ns::CountedTree.
+  iter nth(size_type i) const { return (tree_.nth(i)); }
+
+  size_type rank(const key_type& key) const { return (tree_.rank(key)); }
 
-    return n;
+  difference_type distance(const_iter first, const_iter last) const {
+    return (tree_.distance(first, last));
   }
 
   iter lower_bound(const key_type& key) { return tree_.lower_bound(key); };
@@ -141,20 +240,52 @@ class multiset {
     return tree_.equal_range(key);
   };
 
-  iter find(const key_type& key) {
-    return (contains(key) ? tree_.find(key).first : nullptr);
+  iter find(const key_type& key) const {
+    return (tree_.find(key).first);
   };
 
-  bool contains(const key_type& key) { return (tree_.find(key).second); };
-
-  void merge(multiset& other) {
-    iter first = other.begin();
-    const iter last = other.end();
-    for (; first != last; ++first) insert(*first);
-    insert(*last);
-    other.clear();
+  bool contains(const key_type& key) const {
+    return (tree_.find(key).second);
   };
 
+  // Batched lookups: one iterator, or one bool, per key is written to out.
+  template <typename Keys, typename OutIt>
+  OutIt find_batch(const Keys& keys, OutIt out) const {
+    return (tree_.find_batch(std::begin(keys), std::end(keys), out));
+  }
+
+  template <typename Keys, typename OutIt>
+  OutIt contains_batch(const Keys& keys, OutIt out) const {
+    return (tree_.contains_batch(std::begin(keys), std::end(keys), out));
+  }
+
+  // Heterogeneous lookups, for transparent comparators only.
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  iter find(const K& key) const {
+    return (tree_.find(key).first);
+  }
+
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  bool contains(const K& key) const {
+    return (tree_.find(key).second);
+  }
+
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  size_type count(const K& key) const {
+    return (tree_.count(key));
+  }
+
+  // Moves the nodes of other over; other is left empty.
+  void merge(multiset& other) { tree_.unite_all(other.tree_); };
+
+  // Same, on several threads for large multisets; see ns::parallel_t.
+  void merge(multiset& other, ns::parallel_t) {
+    tree_.unite_all(other.tree_, ns::parallel);
+  }
+
  private:
   tree_type tree_;
 };
@@ -1,6 +1,22 @@
 #ifndef NODE_H_
 #define NODE_H_
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "iterator.h"
+#include "pool.h"
+
 namespace ns {
 
 template <typename T>
@@ -9,6 +25,7 @@ struct ListNode {
   using pointer = value_type*;
   using node_type = ListNode<value_type>;
   using node_pointer = node_type*;
+  using link_pointer = node_pointer;
 
   ListNode(value_type val) : value(val){};
 
@@ -22,623 +39,1969 @@ struct ListNode {
 
 using color_type = enum RBTnode_colors { RED, BLACK };
 
-template <typename T>
-struct RBTnode {
-  using value_type = T;
-  using pointer = value_type*;
-  using node_type = RBTnode<value_type>;
-  using node_pointer = node_type*;
+// Tree link stored as a 32-bit IndexArena index. Reads and writes like the
+// node pointer it stands for.
+template <typename Node>
+class IndexLink {
+ public:
+  explicit IndexLink(Node* node = nullptr)
+      : index_(IndexArena::index(node)) {}
 
-  RBTnode(const value_type& val, const color_type& col = RED)
-      : parent(nullptr),
-        left(nullptr),
-        right(nullptr),
-        value(val),
-        color(col){};
-  RBTnode(const RBTnode& other) {
-    parent = other.parent;
-    left = other.left;
-    right = other.right;
-    value = other.value;
-    color = other.color;
-  };
-  RBTnode(RBTnode&& other, const value_type& val, const color_type& col = RED)
-      : parent(nullptr), left(nullptr), right(nullptr), value(val), color(col) {
-    swap(other);
-  };
-  ~RBTnode(){};
+  IndexLink& operator=(Node* node) {
+    index_ = IndexArena::index(node);
+    return *this;
+  }
 
-  RBTnode& operator=(const RBTnode& other) {
-    if (this == &other) return *this;
-    parent = other.parent;
-    left = other.left;
-    right = other.right;
-    value = other.value;
-    color = other.color;
-    return (*this);
-  };
+  operator Node*() const {
+    return static_cast<Node*>(IndexArena::address(index_));
+  }
 
-  RBTnode& operator=(RBTnode&& other) {
-    if (this == &other) return *this;
-    swap(other);
-    return (*this);
-  };
+  Node* operator->() const { return *this; }
+
+ private:
+  std::uint32_t index_;
+};
+
+// Link layouts for tree nodes. PointerLinks keeps plain pointers;
+// IndexLinks keeps IndexArena indices, for nodes that come from an
+// IndexPoolAllocator. Either way the color takes the low bit of the parent
+// word.
+struct PointerLinks {
+  template <typename Node>
+  using link = Node*;
+  using word = std::uintptr_t;
+
+  static word encode(const void* node) {
+    return reinterpret_cast<word>(node);
+  }
+  static void* decode(word bits) { return reinterpret_cast<void*>(bits); }
+};
+
+struct IndexLinks {
+  template <typename Node>
+  using link = IndexLink<Node>;
+  using word = std::uint32_t;
+
+  static word encode(const void* node) { return IndexArena::index(node) << 1; }
+  static void* decode(word bits) { return IndexArena::address(bits >> 1); }
+};
+
+// The layout for trees on Alloc: IndexLinks for arena allocators.
+template <typename Alloc, typename = void>
+struct node_links {
+  using type = PointerLinks;
+};
 
-  node_pointer min() {
-    if (left == nullptr) return this;
-    node_pointer node = this;
+template <typename Alloc>
+struct node_links<Alloc, std::void_t<typename Alloc::arena_type>> {
+  using type = IndexLinks;
+};
+
+template <typename Alloc>
+using node_links_t = typename node_links<Alloc>::type;
+
+// Links and color of a tree node. RBTree keeps one of these as a header:
+// its parent is the root, its left and right are the leftmost and rightmost
+// nodes, and it is the end() position. The header is the only red node
+// whose parent's parent is itself, which is how iteration recognises it.
+template <typename Links = PointerLinks>
+struct RBTnodeBase {
+  using base_pointer = RBTnodeBase*;
+  using link_type = typename Links::template link<RBTnodeBase>;
+
+  RBTnodeBase(const color_type& col = RED)
+      : left(nullptr), right(nullptr), parent_color_(col){};
+
+  static base_pointer minimum(base_pointer node) {
     while (node->left != nullptr) node = node->left;
     return (node);
   };
 
-  node_pointer max() {
-    if (right == nullptr) return this;
-    node_pointer node = this;
+  static base_pointer maximum(base_pointer node) {
     while (node->right != nullptr) node = node->right;
     return (node);
   };
 
-  node_pointer grandparent() {
-    node_pointer node = this;
-    return ((node != nullptr && node->parent != nullptr) ? node->parent->parent
-                                                         : nullptr);
+  inline bool is_header() const {
+    return (color() == RED &&
+            (parent() == nullptr || parent()->parent() == this));
   };
 
-  node_pointer uncle() {
-    node_pointer node = grandparent();
-    if (node == nullptr) return nullptr;
-    return parent == node->left ? node->right : node->left;
+  // Stays on the header once there.
+  inline base_pointer forward() {
+    base_pointer node = this;
+    if (node->is_header()) return node;
+    if (node->right != nullptr) return minimum(node->right);
+    base_pointer up = node->parent();
+    while (node == up->right) {
+      node = up;
+      up = up->parent();
+    }
+    return ((node->right != up) ? up : node);
+  }
+
+  // Steps from the header to the rightmost node; nullptr before the leftmost.
+  inline base_pointer back() {
+    base_pointer node = this;
+    if (node->is_header()) return node->right;
+    if (node->left != nullptr) return maximum(node->left);
+    base_pointer up = node->parent();
+    while (!up->is_header() && node == up->left) {
+      node = up;
+      up = up->parent();
+    }
+    return (up->is_header() ? nullptr : up);
   };
 
-  node_pointer brother() {
-    return (this == parent->left ? parent->right : parent->left);
+  // The color lives in the low bit of the parent word, which node alignment
+  // or the index encoding leaves free.
+  base_pointer parent() const {
+    return static_cast<base_pointer>(Links::decode(parent_color_ & ~kColorBit));
+  }
+
+  void set_parent(base_pointer node) {
+    parent_color_ = Links::encode(node) | (parent_color_ & kColorBit);
+  }
+
+  color_type color() const {
+    return static_cast<color_type>(parent_color_ & kColorBit);
+  }
+
+  void set_color(color_type col) {
+    parent_color_ = (parent_color_ & ~kColorBit) | col;
+  }
+
+  link_type left;
+  link_type right;
+
+ private:
+  using word = typename Links::word;
+
+  static constexpr word kColorBit = 1;
+
+  word parent_color_;
+};
+
+template <typename T, typename Links = PointerLinks>
+struct RBTnode : RBTnodeBase<Links> {
+  using value_type = T;
+  using pointer = value_type*;
+  using node_type = RBTnode<value_type, Links>;
+  using node_pointer = node_type*;
+  using link_pointer = typename RBTnodeBase<Links>::base_pointer;
+
+  // The value is left unbuilt: the tree constructs and destroys it through
+  // its allocator, so that allocator-aware values get the tree's allocator.
+  explicit RBTnode(const color_type& col) : RBTnodeBase<Links>(col){};
+  ~RBTnode(){};
+
+  union {
+    value_type value;
   };
+};
 
-  inline node_pointer forward() {
-    node_pointer curr = this;
-    if (curr == nullptr) return nullptr;
-    if (curr->right != nullptr) return curr->right->min();
-    if (curr->is_left_child()) return curr->parent;
-    while (curr->is_right_child() && curr != nullptr) {
-      curr = curr->parent;
-    }
-    return ((curr->parent != nullptr) ? curr->parent : nullptr);
+// Node that also keeps the size of its subtree, for CountedTree.
+template <typename T, typename Links = PointerLinks>
+struct RBTcountedNode : RBTnode<T, Links> {
+  explicit RBTcountedNode(const color_type& col)
+      : RBTnode<T, Links>(col), count(1){};
+
+  std::size_t count;
+};
+
+// RBTree augmentation policies. CountedTree keeps subtree sizes in the
+// nodes, which rank/select, O(log n) count() and distance() need, at the
+// price of a word per node and updates along every changed path.
+struct PlainTree {
+  static constexpr bool kCounted = false;
+};
+
+struct CountedTree {
+  static constexpr bool kCounted = true;
+};
+
+// Detects allocators that can set aside room for n objects up front, such
+// as PoolAllocator.
+template <typename Alloc, typename = void>
+struct has_reserve : std::false_type {};
+
+template <typename Alloc>
+struct has_reserve<Alloc, std::void_t<decltype(std::declval<Alloc&>().reserve(
+                              std::size_t()))>> : std::true_type {};
+
+// Owns a node taken out of an RBTree by extract(); insert() links it into
+// another tree with the same allocator without copying the value. Map
+// handles (Mapped) expose key() and mapped(), the others value().
+template <typename Node, typename Allocator, bool Mapped = false>
+class NodeHandle {
+ public:
+  using value_type = typename Node::value_type;
+  using allocator_type = Allocator;
+
+  NodeHandle() : node_(nullptr) {}
+  NodeHandle(NodeHandle&& other) : node_(nullptr) { Take(other); }
+  NodeHandle(const NodeHandle&) = delete;
+
+  NodeHandle& operator=(NodeHandle&& other) {
+    if (this == &other) return *this;
+    Free();
+    Take(other);
+    return (*this);
+  }
+  NodeHandle& operator=(const NodeHandle&) = delete;
+
+  ~NodeHandle() { Free(); }
+
+  bool empty() const { return node_ == nullptr; }
+
+  explicit operator bool() const { return node_ != nullptr; }
+
+  allocator_type get_allocator() const { return *alloc_; }
+
+  value_type& value() const { return node_->value; }
+
+  template <bool M = Mapped, typename = std::enable_if_t<M>>
+  auto& key() const {
+    return node_->value.first;
+  }
+
+  template <bool M = Mapped, typename = std::enable_if_t<M>>
+  auto& mapped() const {
+    return node_->value.second;
+  }
+
+  void swap(NodeHandle& other) {
+    NodeHandle tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
   }
 
-  inline node_pointer back() {
-    node_pointer curr = this;
-    if (curr == nullptr) return nullptr;
-    if (curr->left != nullptr) return curr->left->max();
-    if (curr->is_right_child()) return curr->parent;
-    while (curr->is_left_child() && curr != nullptr) {
-      curr = curr->parent;
+ private:
+  template <typename, typename, typename, typename>
+  friend class RBTree;
+
+  using alloc_traits = std::allocator_traits<allocator_type>;
+
+  NodeHandle(Node* node, const allocator_type& alloc)
+      : node_(node), alloc_(alloc) {}
+
+  void Take(NodeHandle& other) {
+    node_ = other.node_;
+    if (other.alloc_) alloc_.emplace(std::move(*other.alloc_));
+    other.node_ = nullptr;
+    other.alloc_.reset();
+  }
+
+  Node* Release() {
+    Node* node = node_;
+    node_ = nullptr;
+    alloc_.reset();
+    return node;
+  }
+
+  void Free() {
+    if (node_ != nullptr) {
+      alloc_traits::destroy(*alloc_, std::addressof(node_->value));
+      alloc_traits::destroy(*alloc_, node_);
+      alloc_traits::deallocate(*alloc_, node_, 1);
     }
-    return ((curr != nullptr) ? curr->parent : nullptr);
-  };
+    node_ = nullptr;
+    alloc_.reset();
+  }
 
-  inline bool is_node() const { return (parent != nullptr); };
-  inline bool is_right_child() const {
-    return (parent != nullptr && this == parent->right);
-  };
-  inline bool is_left_child() const {
-    return (parent != nullptr && this == parent->left);
-  };
-  inline bool has_only_one_child() const {
-    return ((left == nullptr && right != nullptr) ||
-            (right == nullptr && left != nullptr));
-  };
-  bool operator==(const RBTnode& other) { return value == other.value; };
-  bool operator!=(const RBTnode& other) { return value != other.value; };
-  value_type& operator*() { return value; };
-
-  void swap(RBTnode& other) {
-    std::swap(parent, other.parent);
-    std::swap(left, other.left);
-    std::swap(right, other.right);
-    std::swap(value, other.value);
-    std::swap(color, other.color);
-  };
+  Node* node_;
+  std::optional<allocator_type> alloc_;
+};
 
-  node_pointer parent;
-  node_pointer left;
-  node_pointer right;
-  value_type value;
-  color_type color;
+// What inserting a node handle into a unique container returns; node holds
+// the handle back when an equivalent element was already there.
+template <typename Iter, typename Handle>
+struct InsertReturn {
+  Iter position;
+  bool inserted;
+  Handle node;
+};
+
+// Comparators declaring is_transparent, like std::less<>, let lookups take
+// any key type comparable with the stored keys.
+template <typename Compare, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename Compare>
+struct is_transparent<Compare, std::void_t<typename Compare::is_transparent>>
+    : std::true_type {};
+
+// Comparators with a compare(a, b) member returning <0, 0 or >0 tell all
+// three outcomes in one call; RBTree uses it where it needs to tell equal
+// elements apart, instead of calling operator() twice.
+template <typename Compare, typename A, typename B, typename = void>
+struct has_three_way : std::false_type {};
+
+template <typename Compare, typename A, typename B>
+struct has_three_way<
+    Compare, A, B,
+    std::void_t<decltype(std::declval<const Compare&>().compare(
+        std::declval<const A&>(), std::declval<const B&>()))>>
+    : std::true_type {};
+
+// Detects a.compare(b), as on std::string and std::string_view.
+template <typename A, typename B, typename = void>
+struct has_compare_member : std::false_type {};
+
+template <typename A, typename B>
+struct has_compare_member<A, B,
+                          std::void_t<decltype(std::declval<const A&>().compare(
+                              std::declval<const B&>()))>> : std::true_type {};
+
+// std::less with a three-way compare(): a.compare(b) when the key type has
+// one, two operator< calls otherwise. three_way_less<> is transparent.
+template <typename T = void>
+struct three_way_less {
+  bool operator()(const T& a, const T& b) const { return a < b; }
+
+  int compare(const T& a, const T& b) const {
+    if constexpr (has_compare_member<T, T>::value)
+      return a.compare(b);
+    else
+      return a < b ? -1 : b < a;
+  }
+};
+
+template <>
+struct three_way_less<void> {
+  using is_transparent = void;
+
+  template <typename A, typename B>
+  bool operator()(const A& a, const B& b) const {
+    return a < b;
+  }
+
+  template <typename A, typename B>
+  int compare(const A& a, const B& b) const {
+    if constexpr (has_compare_member<A, B>::value)
+      return a.compare(b);
+    else if constexpr (has_compare_member<B, A>::value)
+      return -b.compare(a);
+    else
+      return a < b ? -1 : b < a;
+  }
 };
 
-template <typename T, typename Compare, typename Allocator>
+template <typename T, typename Compare, typename Allocator,
+          typename Policy = PlainTree>
 class RBTree {
  public:
+  static constexpr bool kCounted = Policy::kCounted;
+
   using value_type = T;
   using pointer = value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
-  using node_type = RBTnode<value_type>;
+  using links_type = node_links_t<Allocator>;
+  using base_node = RBTnodeBase<links_type>;
+  using node_type = typename std::conditional<
+      kCounted, RBTcountedNode<value_type, links_type>,
+      RBTnode<value_type, links_type>>::type;
   using node_pointer = node_type*;
+  using base_pointer = typename base_node::base_pointer;
   using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
   using compare_type = Compare;
-  using iter = ns::BDIter<T, node_type>;
-  using const_iter = ns::BDIter<const T, node_type>;
-  using allocator_type = typename Allocator::template rebind<node_type>::other;
+  using iter = ns::BDIter<T, RBTnode<value_type, links_type>>;
+  using const_iter = ns::BDIter<const T, RBTnode<value_type, links_type>>;
+  using allocator_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<node_type>;
+
+  // Parallel copies of trees at least this large are split across threads.
+  static constexpr size_type kParallelCopyThreshold = 1 << 15;
 
   RBTree(const allocator_type& alloc = allocator_type(),
          const compare_type& comp = compare_type())
-      : alloc_(alloc), comp_(comp), root_(), size_(){};
+      : alloc_(alloc), comp_(comp), header_(NewHeader()), size_(0) {
+    Reset();
+  };
 
   RBTree(const RBTree& other)
-      : alloc_(other.alloc_), comp_(other.comp_), root_(), size_(0) {
-    if (!other.size()) return;
-    root_ = CopyTree(other.root_, nullptr);
-    size_ = other.size_;
+      : RBTree(other, alloc_traits::select_on_container_copy_construction(
+                          other.alloc_)){};
+
+  // The copying and moving constructors delegate, so that the destructor
+  // releases the header should the copy throw.
+  RBTree(const RBTree& other, const allocator_type& alloc)
+      : RBTree(alloc, other.comp_) {
+    CopyFrom(other);
   };
 
-  RBTree(RBTree&& other, const allocator_type& alloc = allocator_type(),
-         const compare_type& comp = compare_type())
-      : alloc_(alloc), comp_(comp), root_(), size_() {
-    swap(other);
+  // Copy that may split a large tree across threads.
+  RBTree(ns::parallel_t, const RBTree& other)
+      : RBTree(alloc_traits::select_on_container_copy_construction(
+                   other.alloc_),
+               other.comp_) {
+    CopyFrom(other, true);
+  };
+
+  RBTree(RBTree&& other) : RBTree(other.alloc_, other.comp_) {
+    Exchange(other);
   };
 
-  ~RBTree() { clear(); };
+  RBTree(RBTree&& other, const allocator_type& alloc)
+      : RBTree(alloc, other.comp_) {
+    if (alloc_ == other.alloc_) {
+      Exchange(other);
+    } else {
+      CopyFrom(other);
+      other.clear();
+    }
+  };
+
+  ~RBTree() {
+    clear();
+    FreeHeader();
+  };
 
   RBTree& operator=(const RBTree& other) {
     if (this == &other) return *this;
     clear();
-    if (!other.size()) return *this;
-    RBTree tmp(other);
-    swap(tmp);
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+      alloc_ = other.alloc_;
+    comp_ = other.comp_;
+    CopyFrom(other);
     return (*this);
   }
 
   RBTree& operator=(RBTree&& other) {
-    if (this != &other) {
-      clear();
-      swap(other);
+    if (this == &other) return *this;
+    clear();
+    comp_ = other.comp_;
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+      alloc_ = other.alloc_;
+      Exchange(other);
+    } else if (alloc_ == other.alloc_) {
+      Exchange(other);
+    } else {
+      CopyFrom(other);
+      other.clear();
     }
     return (*this);
   }
 
+  allocator_type get_allocator() const { return alloc_; }
+
   void clear() {
     if (!size()) return;
-    ClearTree(root_);
-    size_ = 0;
-    root_ = nullptr;
+    ClearTree(Root(), alloc_);
+    Reset();
   }
 
-  std::pair<iter, bool> build_root(const_reference val) {
-    return std::make_pair(iter(root_ = NewNode(val, BLACK)), true);
-  }
+  iter begin() const { return iter(Header()->left); }
 
-  iter start() const { return (root_ ? iter(root_->min()) : nullptr); }
+  iter end() const { return iter(Header()); }
 
-  iter edge() const { return (root_ ? iter(root_->max()) : nullptr); }
+  const_iter cbegin() const { return const_iter(Header()->left); }
 
-  const_iter cstart() const {
-    return (root_ ? const_iter(root_->min()) : nullptr);
-  }
-  const_iter cedge() const {
-    return (root_ ? const_iter(root_->max()) : nullptr);
+  const_iter cend() const { return const_iter(Header()); }
+
+  // Calls f on every element in order and returns f. Instead of climbing
+  // parent links like the iterators, the walk keeps the path on a stack
+  // and prefetches each right subtree while f runs on its parent.
+  template <typename F>
+  F for_each(F f) const {
+    Walk([&f](reference val) { f(static_cast<const_reference>(val)); });
+    return f;
   }
 
   size_type const& size() const { return size_; }
 
   size_type max_size(void) const { return alloc_.max_size(); }
 
-  std::pair<iter, bool> find(const_reference val) {
-    node_pointer curr = root_;
+  // Lookups take any key that comp_ orders against value_type; containers
+  // pass foreign key types through only for transparent comparators.
+  template <typename K>
+  std::pair<iter, bool> find(const K& key) const {
+    base_pointer curr = Root();
     while (curr != nullptr) {
-      if (comp_(val, curr->value))
+      int order = Order(key, Value(curr));
+      if (order < 0)
         curr = curr->left;
-      else if (comp_(curr->value, val))
+      else if (order > 0)
         curr = curr->right;
       else
         return std::make_pair(iter(curr), true);
     }
-    return (std::make_pair(iter(curr), false));
+    return (std::make_pair(end(), false));
+  }
+
+  // Looks up every key of the forward range [first, last) and writes one
+  // iterator per key to out, end() for the missing ones; contains_batch
+  // writes bools. Same results as a loop over find, with the cache misses
+  // of neighbouring lookups overlapped.
+  template <typename ForwardIt, typename OutIt>
+  OutIt find_batch(ForwardIt first, ForwardIt last, OutIt out) const {
+    Batch(first, last, [&out](base_pointer node) { *out++ = iter(node); });
+    return out;
+  }
+
+  template <typename ForwardIt, typename OutIt>
+  OutIt contains_batch(ForwardIt first, ForwardIt last, OutIt out) const {
+    Batch(first, last,
+          [&out, this](base_pointer node) { *out++ = node != Header(); });
+    return out;
   }
 
   std::pair<iter, bool> insert(const_reference val) {
-    if (!size()) return build_root(val);
-    node_pointer curr = root_;
+    return (Place(Descend(val, true), val));
+  }
+
+  std::pair<iter, bool> insert(value_type&& val) {
+    return (Place(Descend(val, true), std::move(val)));
+  }
+
+  std::pair<iter, bool> insert_all(const_reference val) {
+    return (Place(Descend(val, false), val));
+  }
+
+  std::pair<iter, bool> insert_all(value_type&& val) {
+    return (Place(Descend(val, false), std::move(val)));
+  }
+
+  // Hinted insertion: constant time when val belongs right before hint (or
+  // right after it), a full descent otherwise.
+  iter insert(const_iter hint, const_reference val) {
+    return (Place(HintSlot(hint.base(), val, true), val).first);
+  }
+
+  iter insert(const_iter hint, value_type&& val) {
+    return (Place(HintSlot(hint.base(), val, true), std::move(val)).first);
+  }
+
+  iter insert_all(const_iter hint, const_reference val) {
+    return (Place(HintSlot(hint.base(), val, false), val).first);
+  }
+
+  iter insert_all(const_iter hint, value_type&& val) {
+    return (Place(HintSlot(hint.base(), val, false), std::move(val)).first);
+  }
+
+  // Builds value_type(args...) in a new node only if no element is
+  // equivalent to key; otherwise nothing is constructed.
+  template <typename K, typename... Args>
+  std::pair<iter, bool> try_emplace(const K& key, Args&&... args) {
+    return (Place(Descend(key, true), std::forward<Args>(args)...));
+  }
+
+  // In-place construction. The node is built first, as its value is what
+  // gets compared, and freed again if a unique tree already has the key.
+  template <typename... Args>
+  std::pair<iter, bool> emplace(Args&&... args) {
+    return (Emplace(nullptr, true, std::forward<Args>(args)...));
+  }
+
+  template <typename... Args>
+  iter emplace_all(Args&&... args) {
+    return (Emplace(nullptr, false, std::forward<Args>(args)...).first);
+  }
+
+  template <typename... Args>
+  iter emplace_hint(const_iter hint, Args&&... args) {
+    return (Emplace(hint.base(), true, std::forward<Args>(args)...).first);
+  }
+
+  template <typename... Args>
+  iter emplace_hint_all(const_iter hint, Args&&... args) {
+    return (Emplace(hint.base(), false, std::forward<Args>(args)...).first);
+  }
+
+  // Replaces the contents with [first, last), which has to be sorted, in
+  // linear time; debug builds assert the order. With unique set, only the
+  // first of equivalent elements is kept. Nodes are allocated in order,
+  // after reserving room for all of them when the allocator can.
+  template <typename InputIt>
+  void assign_sorted(InputIt first, InputIt last, bool unique) {
+    clear();
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (has_reserve<allocator_type>::value &&
+                  std::is_base_of<std::forward_iterator_tag, category>::value)
+      alloc_.reserve(std::distance(first, last));
+    base_node chain;
+    base_pointer tail = &chain;
+    size_type count = 0;
+    try {
+      for (; first != last; ++first) {
+        assert((!count || !comp_(*first, Value(tail))) &&
+               "assign_sorted: input is not sorted");
+        if (unique && count && !comp_(Value(tail), *first)) continue;
+        tail->right = MakeNode(alloc_, BLACK, *first);
+        tail = tail->right;
+        ++count;
+      }
+    } catch (...) {
+      for (base_pointer node = chain.right; count--;) {
+        base_pointer next = node->right;
+        FreeNode(node, alloc_);
+        node = next;
+      }
+      throw;
+    }
+    BuildFrom(chain.right, count);
+  }
+
+  std::pair<iter, bool> insert_or_assign(const_reference val) {
+    std::pair<iter, bool> result = insert(val);
+    if (!result.second) *result.first = val;
+    return (result);
+  }
+
+  void erase(iter pos) {
+    base_pointer node = pos.base();
+    if (node == nullptr || node == Header()) return;
+    DelNode(Detach(node));
+  }
+
+  // Erases [first, last) and returns how many elements went. The first
+  // kBulkEraseMin go one at a time; the rest of a longer range is cut out
+  // with two splits and a join, O(log n) plus freeing the nodes.
+  size_type erase(const_iter first, const_iter last) {
+    base_pointer node = first.base();
+    base_pointer stop = last.base();
+    if (node == Header()->left && stop == Header()) {
+      size_type erased = size_;
+      clear();
+      return (erased);
+    }
+    size_type erased = 0;
+    for (; node != stop && erased < kBulkEraseMin; ++erased) {
+      base_pointer next = node->forward();
+      DelNode(Detach(node));
+      node = next;
+    }
+    if (node != stop) erased += Cut(node, stop);
+    return (erased);
+  }
+
+  // Erases the elements matching pred in one in-order pass and returns how
+  // many went. Matches are unlinked one by one until they reach
+  // 1/kRebuildDivisor of the tree; from then on the survivors are rebuilt
+  // into a fresh tree in linear time instead.
+  template <typename Pred>
+  size_type erase_if(Pred pred) {
+    size_type erased = 0;
+    size_type limit = size_ / kRebuildDivisor;
+    for (base_pointer node = Header()->left; node != Header();) {
+      if (erased >= limit) return (erased + Rebuild(node, pred));
+      base_pointer next = node->forward();
+      if (pred(static_cast<const_reference>(Value(node)))) {
+        DelNode(Detach(node));
+        ++erased;
+      }
+      node = next;
+    }
+    return (erased);
+  }
+
+  // Node handles; Handle is a NodeHandle over node_type and allocator_type.
+  // extract() unlinks the element without freeing it, end() gives an empty
+  // handle.
+  template <typename Handle>
+  Handle extract(const_iter pos) {
+    base_pointer node = pos.base();
+    if (node == nullptr || node == Header()) return Handle();
+    node = Detach(node);
+    --size_;
+    return Handle(static_cast<node_pointer>(node), alloc_);
+  }
+
+  // Links the node of handle in and empties handle, unless unique is set and
+  // an equivalent element is there already; handle then keeps its node. A
+  // node from an allocator that does not compare equal is copied instead.
+  template <typename Handle>
+  std::pair<iter, bool> insert_node(Handle& handle, bool unique) {
+    if (handle.empty()) return std::make_pair(end(), false);
+    Slot slot = Descend(handle.value(), unique);
+    if (slot.found) return std::make_pair(iter(slot.parent), false);
+    if (!(*handle.alloc_ == alloc_)) {
+      std::pair<iter, bool> result = Place(slot, handle.value());
+      handle.Free();
+      return (result);
+    }
+    node_pointer node = handle.Release();
+    node->left = node->right = nullptr;
+    node->set_color(RED);
+    Recount(node);
+    ++size_;
+    return (std::make_pair(iter(Attach(slot.parent, slot.left, node)), true));
+  }
+
+  // Allocators are exchanged only if they propagate on swap; otherwise they
+  // have to compare equal.
+  void swap(RBTree& other) {
+    if constexpr (alloc_traits::propagate_on_container_swap::value)
+      std::swap(alloc_, other.alloc_);
+    std::swap(comp_, other.comp_);
+    Exchange(other);
+  }
+
+  void print() {
+    for (iter first = begin(); first != end(); ++first) {
+      std::cout << "key: " << (*first).first << " value: " << (*first).second
+                << " color: " << first.operator->()->color() << std::endl;
+    }
+  }
+
+  void print_mult() {
+    for (iter first = begin(); first != end(); ++first) {
+      std::cout << "value: " << *first
+                << " color: " << first.operator->()->color() << std::endl;
+    }
+  }
+
+  // Checks the red-black invariants: black root, no red node with a red
+  // child and the same number of black nodes on every path down.
+  bool is_balanced() const {
+    base_pointer node = Root();
+    if (node == nullptr) return true;
+    if (node->color() != BLACK) return false;
+    base_pointer prev = Header();
+    int black = 0;
+    int expected = -1;
+    while (node != Header()) {
+      base_pointer next;
+      if (prev == node->parent()) {
+        if (node->color() == BLACK)
+          ++black;
+        else if (node->parent()->color() == RED)
+          return false;
+        if (node->left == nullptr || node->right == nullptr) {
+          if (expected < 0) expected = black;
+          if (black != expected) return false;
+        }
+        next = node->left ? node->left
+                          : (node->right ? node->right : node->parent());
+      } else if (prev == node->left && node->right != nullptr) {
+        next = node->right;
+      } else {
+        next = node->parent();
+      }
+      if (next == node->parent() && node->color() == BLACK) --black;
+      prev = node;
+      node = next;
+    }
+    return true;
+  }
+
+  template <typename K>
+  iter lower_bound(const K& key) const {
+    base_pointer curr = Root();
+    base_pointer result = Header();
     while (curr != nullptr) {
-      if (!comp_(val, curr->value) && !comp_(curr->value, val)) {
-        return std::make_pair(iter(curr), false);
-      } else if (comp_(val, curr->value)) {
-        if (curr->left == nullptr) return insert_left(curr, val);
+      if (!comp_(Value(curr), key)) {
+        result = curr;
         curr = curr->left;
       } else {
-        if (curr->right == nullptr) return insert_right(curr, val);
         curr = curr->right;
       }
     }
-    return (std::make_pair(iter(curr), false));
+    return (iter(result));
   }
 
-  std::pair<iter, bool> insert_all(const_reference val) {
-    if (!size()) return build_root(val);
-    node_pointer curr = root_;
+  template <typename K>
+  iter upper_bound(const K& key) const {
+    base_pointer curr = Root();
+    base_pointer result = Header();
     while (curr != nullptr) {
-      if (comp_(val, curr->value)) {
-        if (curr->left == nullptr) return insert_left(curr, val);
+      if (comp_(key, Value(curr))) {
+        result = curr;
         curr = curr->left;
       } else {
-        if (curr->right == nullptr) return insert_right(curr, val);
         curr = curr->right;
       }
     }
-    return (std::make_pair(iter(curr), false));
+    return (iter(result));
   }
 
-  std::pair<iter, bool> insert_or_assign(const_reference val) {
-    if (!size()) return build_root(val);
-    node_pointer curr = root_;
-    while (curr != nullptr) {
-      if (!comp_(val, curr->value) && !comp_(curr->value, val)) {
-        curr->value = val;
-        return std::make_pair(iter(curr), false);
+  template <typename K>
+  std::pair<iter, iter> equal_range(const K& key) const {
+    iter lower = lower_bound(key);
+    iter upper = upper_bound(key);
+    return std::make_pair(lower, upper);
+  }
 
-      } else if (comp_(val, curr->value)) {
-        if (curr->left == nullptr) return insert_left(curr, val);
-        curr = curr->left;
+  // Order statistics, CountedTree only. nth(i) is the i-th element in order
+  // or end(), rank(key) the number of elements less than key and index(pos)
+  // the position of pos, size() for end().
+  iter nth(size_type i) const {
+    static_assert(kCounted, "nth() needs a CountedTree");
+    base_pointer node = Root();
+    while (node != nullptr) {
+      size_type left = Count(node->left);
+      if (i < left) {
+        node = node->left;
+      } else if (i == left) {
+        return iter(node);
+      } else {
+        i -= left + 1;
+        node = node->right;
+      }
+    }
+    return (end());
+  }
 
+  template <typename K>
+  size_type rank(const K& key) const {
+    static_assert(kCounted, "rank() needs a CountedTree");
+    size_type result = 0;
+    base_pointer node = Root();
+    while (node != nullptr) {
+      if (comp_(Value(node), key)) {
+        result += Count(node->left) + 1;
+        node = node->right;
       } else {
-        if (curr->right == nullptr) return insert_right(curr, val);
-        curr = curr->right;
+        node = node->left;
       }
     }
-    return (std::make_pair(iter(curr), false));
+    return (result);
   }
 
-  std::pair<iter, bool> insert_left(node_pointer ptr, const_reference val) {
-    ptr->left = NewNode(val);
-    ptr->left->parent = ptr;
-    insert_case1(ptr->left);
-    return (std::make_pair(iter(ptr->left), true));
+  size_type index(const_iter pos) const {
+    static_assert(kCounted, "index() needs a CountedTree");
+    base_pointer node = pos.base();
+    if (node == Header()) return size_;
+    size_type result = Count(node->left);
+    for (; node != Root(); node = node->parent()) {
+      if (node == node->parent()->right)
+        result += Count(node->parent()->left) + 1;
+    }
+    return (result);
   }
 
-  std::pair<iter, bool> insert_right(node_pointer ptr, const_reference val) {
-    ptr->right = NewNode(val);
-    ptr->right->parent = ptr;
-    insert_case1(ptr->right);
-    return (std::make_pair(iter(ptr->right), true));
+  difference_type distance(const_iter first, const_iter last) const {
+    return (static_cast<difference_type>(index(last)) -
+            static_cast<difference_type>(index(first)));
   }
 
-  void insert_case1(node_pointer ptr) {
-    if (ptr->parent == nullptr)
-      ptr->color = BLACK;
-    else
-      insert_case2(ptr);
+  // Number of elements equivalent to key: two descents on a CountedTree, a
+  // walk over the matches otherwise.
+  template <typename K>
+  size_type count(const K& key) const {
+    if constexpr (kCounted) {
+      size_type not_greater = 0;
+      base_pointer node = Root();
+      while (node != nullptr) {
+        if (comp_(key, Value(node))) {
+          node = node->left;
+        } else {
+          not_greater += Count(node->left) + 1;
+          node = node->right;
+        }
+      }
+      return (not_greater - rank(key));
+    } else {
+      size_type result = 0;
+      for (iter it = lower_bound(key), last = upper_bound(key); it != last;
+           ++it)
+        ++result;
+      return (result);
+    }
+  }
+
+  // Set algebra by split and join. The result is built from the nodes of
+  // both trees, other is left empty and the nodes not kept are freed; on
+  // equivalent elements the one from this tree is kept. Each runs in
+  // O(m log(n / m + 1)) for sizes m <= n. Allocators that do not compare
+  // equal get other's elements copied first.
+  void unite(RBTree& other) { Combine(other, kUnion, true, false); }
+
+  // Keeps every element of both trees.
+  void unite_all(RBTree& other) { Combine(other, kUnion, false, false); }
+
+  void intersect(RBTree& other) {
+    Combine(other, kIntersection, true, false);
+  }
+
+  void subtract(RBTree& other) { Combine(other, kDifference, true, false); }
+
+  // Same, recursing on several threads when both trees are large.
+  void unite(RBTree& other, ns::parallel_t) {
+    Combine(other, kUnion, true, true);
+  }
+
+  void unite_all(RBTree& other, ns::parallel_t) {
+    Combine(other, kUnion, false, true);
+  }
+
+  void intersect(RBTree& other, ns::parallel_t) {
+    Combine(other, kIntersection, true, true);
+  }
+
+  void subtract(RBTree& other, ns::parallel_t) {
+    Combine(other, kDifference, true, true);
+  }
+
+ private:
+  using alloc_traits = std::allocator_traits<allocator_type>;
+
+  // Index links reach only arena blocks, so trees on an arena allocator keep
+  // their header there as well.
+  static constexpr bool kArenaHeader =
+      std::is_same<links_type, IndexLinks>::value;
+
+  allocator_type alloc_;
+  compare_type comp_;
+  typename std::conditional<kArenaHeader, base_pointer, base_node>::type
+      header_;
+  size_type size_;
+
+  static reference Value(base_pointer node) {
+    return static_cast<node_pointer>(node)->value;
   }
 
-  void insert_case2(node_pointer ptr) {
-    if (ptr->parent->color == BLACK) return;
-    insert_case3(ptr);
+  base_pointer Header() const {
+    if constexpr (kArenaHeader)
+      return header_;
+    else
+      return const_cast<base_pointer>(&header_);
   }
 
-  void insert_case3(node_pointer ptr) {
-    node_pointer u = ptr->uncle();
-    node_pointer g = ptr->grandparent();
-    if (u != nullptr && u->color == RED) {
-      ptr->parent->color = BLACK;
-      u->color = BLACK;
-      g->color = RED;
-      insert_case1(g);
+  auto NewHeader() {
+    if constexpr (kArenaHeader) {
+      node_pointer ptr = alloc_traits::allocate(alloc_, 1);
+      alloc_traits::construct(alloc_, ptr, RED);
+      return static_cast<base_pointer>(ptr);
     } else {
-      insert_case4(ptr);
+      return base_node();
+    }
+  }
+
+  void FreeHeader() {
+    if constexpr (kArenaHeader) {
+      node_pointer ptr = static_cast<node_pointer>(header_);
+      alloc_traits::destroy(alloc_, ptr);
+      alloc_traits::deallocate(alloc_, ptr, 1);
+    }
+  }
+
+  // Hints that node is about to be read; a no-op without compiler support.
+  static void Prefetch(base_pointer node) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(node);
+#else
+    (void)node;
+#endif
+  }
+
+  // Runs up to kBatchWidth descents in lockstep: each round moves every
+  // unfinished one a level down and prefetches the node it reached, so the
+  // misses of the whole group are in flight at once. Results are handed to
+  // emit in input order, Header() for a missing key. The keys are read in
+  // place through saved iterators, hence the forward iterators.
+  template <typename ForwardIt, typename Emit>
+  void Batch(ForwardIt first, ForwardIt last, Emit emit) const {
+    using category =
+        typename std::iterator_traits<ForwardIt>::iterator_category;
+    static_assert(
+        std::is_base_of<std::forward_iterator_tag, category>::value,
+        "batched lookups need forward iterators");
+    ForwardIt keys[kBatchWidth];
+    base_pointer curr[kBatchWidth];
+    base_pointer found[kBatchWidth];
+    while (first != last) {
+      int width = 0;
+      for (; width < kBatchWidth && first != last; ++first, ++width) {
+        keys[width] = first;
+        curr[width] = Root();
+        found[width] = Header();
+      }
+      for (bool busy = true; busy;) {
+        busy = false;
+        for (int i = 0; i < width; ++i) {
+          if (curr[i] == nullptr) continue;
+          int order = Order(*keys[i], Value(curr[i]));
+          if (order == 0) {
+            found[i] = curr[i];
+            curr[i] = nullptr;
+            continue;
+          }
+          curr[i] = order < 0 ? curr[i]->left : curr[i]->right;
+          if (curr[i] != nullptr) {
+            Prefetch(curr[i]);
+            busy = true;
+          }
+        }
+      }
+      for (int i = 0; i < width; ++i) emit(found[i]);
     }
   }
 
-  void insert_case4(node_pointer ptr) {
-    node_pointer g = ptr->grandparent();
-    if (ptr == ptr->parent->right && ptr->parent == g->left) {
-      rotate_left(ptr->parent);
-      ptr = ptr->left;
-    } else if (ptr == ptr->left && ptr->parent == g->right) {
-      rotate_right(ptr->parent);
-      ptr = ptr->right;
+  template <typename F>
+  void Walk(F visit) const {
+    base_pointer stack[kMaxDepth];
+    int depth = 0;
+    base_pointer node = Root();
+    while (true) {
+      for (; node != nullptr; node = node->left) stack[depth++] = node;
+      if (depth == 0) return;
+      node = stack[--depth];
+      base_pointer right = node->right;
+      if (right != nullptr) Prefetch(right);
+      visit(Value(node));
+      node = right;
     }
-    insert_case5(ptr);
   }
 
-  void insert_case5(node_pointer ptr) {
-    node_pointer g = ptr->grandparent();
-    ptr->parent->color = BLACK;
-    g->color = RED;
-    if (ptr == ptr->parent->left && ptr->parent == g->left)
-      rotate_right(g);
+  static size_type Count(base_pointer node) {
+    if constexpr (kCounted)
+      return (node != nullptr ? static_cast<node_pointer>(node)->count : 0);
     else
-      rotate_left(g);
+      return (0);
   }
 
-  void rotate_left(node_pointer ptr) {
-    node_pointer pivot = ptr->right;
-    pivot->parent = ptr->parent;
-    if (ptr->parent != nullptr) {
-      if (ptr->parent->left == ptr)
-        ptr->parent->left = pivot;
-      else
-        ptr->parent->right = pivot;
+  // Subtree size upkeep; all of these compile to nothing for PlainTree.
+  static void Recount(base_pointer node) {
+    if constexpr (kCounted)
+      static_cast<node_pointer>(node)->count =
+          1 + Count(node->left) + Count(node->right);
+  }
+
+  static void RecountUp(base_pointer node, base_pointer stop) {
+    if constexpr (kCounted)
+      for (; node != stop; node = node->parent()) Recount(node);
+  }
+
+  static void CopyCount(base_pointer to, base_pointer from) {
+    if constexpr (kCounted)
+      static_cast<node_pointer>(to)->count =
+          static_cast<node_pointer>(from)->count;
+  }
+
+  base_pointer Root() const { return Header()->parent(); }
+
+  void Reset() {
+    Header()->set_color(RED);
+    Header()->set_parent(nullptr);
+    Header()->left = Header()->right = Header();
+    size_ = 0;
+  }
+
+  template <typename... Args>
+  node_pointer NewNode(Args&&... args) {
+    node_pointer ptr = MakeNode(alloc_, RED, std::forward<Args>(args)...);
+    ++size_;
+    return ptr;
+  };
+
+  void DelNode(base_pointer node) {
+    FreeNode(node, alloc_);
+    --size_;
+  };
+
+  // Node construction without the size bookkeeping, so that copies can run
+  // on several threads, each with its own allocator copy. The value is
+  // built in place from args by the allocator's construct.
+  template <typename... Args>
+  static node_pointer MakeNode(allocator_type& alloc, color_type color,
+                               Args&&... args) {
+    node_pointer ptr = alloc_traits::allocate(alloc, 1);
+    alloc_traits::construct(alloc, ptr, color);
+    try {
+      alloc_traits::construct(alloc, std::addressof(ptr->value),
+                              std::forward<Args>(args)...);
+    } catch (...) {
+      alloc_traits::destroy(alloc, ptr);
+      alloc_traits::deallocate(alloc, ptr, 1);
+      throw;
     }
-    ptr->right = pivot->left;
-    if (pivot->left != nullptr) pivot->left->parent = ptr;
-    ptr->parent = pivot;
-    pivot->left = ptr;
-    if (root_->parent != nullptr) root_ = root_->parent;
+    return ptr;
   }
 
-  void rotate_right(node_pointer ptr) {
-    node_pointer pivot = ptr->left;
-    pivot->parent = ptr->parent;
-    if (ptr->parent != nullptr) {
-      if (ptr->parent->left == ptr)
-        ptr->parent->left = pivot;
-      else
-        ptr->parent->right = pivot;
+  static void FreeNode(base_pointer node, allocator_type& alloc) {
+    node_pointer ptr = static_cast<node_pointer>(node);
+    alloc_traits::destroy(alloc, std::addressof(ptr->value));
+    alloc_traits::destroy(alloc, ptr);
+    alloc_traits::deallocate(alloc, ptr, 1);
+  }
+
+  // Swaps the contents, then points each root back at its own header.
+  void Exchange(RBTree& other) {
+    std::swap(header_, other.header_);
+    std::swap(size_, other.size_);
+    Rehome();
+    other.Rehome();
+  }
+
+  void Rehome() {
+    if (Header()->parent() == nullptr)
+      Header()->left = Header()->right = Header();
+    else
+      Header()->parent()->set_parent(Header());
+  }
+
+  // Where a new value goes: under parent, on its left or right side. found
+  // means parent already holds an equivalent value.
+  struct Slot {
+    base_pointer parent;
+    bool left;
+    bool found;
+  };
+
+  // Three-way comparison of key against val.
+  template <typename K>
+  int Order(const K& key, const_reference val) const {
+    if constexpr (has_three_way<compare_type, K, value_type>::value)
+      return comp_.compare(key, val);
+    else
+      return comp_(key, val) ? -1 : comp_(val, key);
+  }
+
+  // Order used to place val: a < b for unique trees, a <= b otherwise, so
+  // equivalent values end up after the ones already there.
+  bool Precedes(const_reference a, const_reference b, bool unique) const {
+    return (unique ? comp_(a, b) : !comp_(b, a));
+  }
+
+  template <typename K>
+  Slot Descend(const K& key, bool unique) const {
+    Slot slot{Header(), true, false};
+    base_pointer curr = Root();
+    while (curr != nullptr) {
+      slot.parent = curr;
+      if (unique) {
+        int order = Order(key, Value(curr));
+        if (order == 0) {
+          slot.found = true;
+          break;
+        }
+        slot.left = order < 0;
+      } else {
+        slot.left = comp_(key, Value(curr));
+      }
+      curr = slot.left ? curr->left : curr->right;
     }
-    ptr->left = pivot->right;
-    if (pivot->right != nullptr) pivot->right->parent = ptr;
-    ptr->parent = pivot;
-    pivot->right = ptr;
-    if (root_->parent != nullptr) root_ = root_->parent;
+    return (slot);
   }
 
-  void erase(iter pos) {
-    if (size_ == 1) {
-      clear();
-      return;
+  // Checks hint and the element before it; when val fits between them the
+  // free child slot of one of the two takes it without a descent. A hint
+  // that does not fit falls back to Descend().
+  Slot HintSlot(base_pointer hint, const_reference val, bool unique) const {
+    if (hint == Header()) {
+      if (size_ && Precedes(Value(Header()->right), val, unique))
+        return Slot{Header()->right, false, false};
+    } else if (Precedes(val, Value(hint), unique)) {
+      if (hint == Header()->left) return Slot{hint, true, false};
+      base_pointer before = hint->back();
+      if (Precedes(Value(before), val, unique)) {
+        if (before->right == nullptr) return Slot{before, false, false};
+        return Slot{hint, true, false};
+      }
+    } else if (unique && !comp_(Value(hint), val)) {
+      return Slot{hint, false, true};
+    } else {
+      if (hint == Header()->right) return Slot{hint, false, false};
+      base_pointer after = hint->forward();
+      if (Precedes(val, Value(after), unique)) {
+        if (hint->right == nullptr) return Slot{hint, false, false};
+        return Slot{after, true, false};
+      }
     }
-    replace(pos.operator->());
+    return (Descend(val, unique));
+  }
+
+  template <typename... Args>
+  std::pair<iter, bool> Place(const Slot& slot, Args&&... args) {
+    if (slot.found) return std::make_pair(iter(slot.parent), false);
+    node_pointer node = NewNode(std::forward<Args>(args)...);
+    return (std::make_pair(iter(Attach(slot.parent, slot.left, node)), true));
   }
 
-  void replace(node_pointer ptr) {
-    if (ptr == nullptr) return;
-    node_pointer to_delete = ptr;
-    if (ptr->right != nullptr && ptr->left != nullptr) {
-      std::swap(ptr->value, ptr->right->min()->value);
-      to_delete = ptr->right->min();
+  // Builds the node, then finds its slot, next to hint if there is one.
+  template <typename... Args>
+  std::pair<iter, bool> Emplace(base_pointer hint, bool unique,
+                                Args&&... args) {
+    node_pointer node = NewNode(std::forward<Args>(args)...);
+    Slot slot = hint != nullptr ? HintSlot(hint, Value(node), unique)
+                                : Descend(Value(node), unique);
+    if (slot.found) {
+      DelNode(node);
+      return std::make_pair(iter(slot.parent), false);
     }
-    if (to_delete->has_only_one_child()) {
-      delete_one_child(to_delete);
+    return (std::make_pair(iter(Attach(slot.parent, slot.left, node)), true));
+  }
+
+  // Hangs a new node under parent and rebalances; parent is the header when
+  // the tree is empty.
+  base_pointer Attach(base_pointer parent, bool left, base_pointer node) {
+    node->set_parent(parent);
+    if (parent == Header()) {
+      Header()->set_parent(node);
+      Header()->left = Header()->right = node;
+    } else if (left) {
+      parent->left = node;
+      if (parent == Header()->left) Header()->left = node;
     } else {
-      if (to_delete->color == BLACK) {
-        if (to_delete->parent->color == RED) {
-          to_delete->parent->color = BLACK;
+      parent->right = node;
+      if (parent == Header()->right) Header()->right = node;
+    }
+    RecountUp(parent, Header());
+    base_pointer root = Root();
+    InsertFixup(node, root);
+    root->set_color(BLACK);
+    Header()->set_parent(root);
+    return node;
+  }
+
+  // Repairs a red node with a red parent in the tree rooted at root, which
+  // may be a detached subtree. The root itself may be left red.
+  static void InsertFixup(base_pointer node, base_pointer& root) {
+    while (node != root && node->parent()->color() == RED) {
+      base_pointer parent = node->parent();
+      base_pointer grand = parent->parent();
+      if (parent == grand->left) {
+        base_pointer uncle = grand->right;
+        if (uncle != nullptr && uncle->color() == RED) {
+          parent->set_color(BLACK);
+          uncle->set_color(BLACK);
+          grand->set_color(RED);
+          node = grand;
+        } else {
+          if (node == parent->right) {
+            node = parent;
+            RotateLeft(node, root);
+            parent = node->parent();
+          }
+          parent->set_color(BLACK);
+          grand->set_color(RED);
+          RotateRight(grand, root);
+        }
+      } else {
+        base_pointer uncle = grand->left;
+        if (uncle != nullptr && uncle->color() == RED) {
+          parent->set_color(BLACK);
+          uncle->set_color(BLACK);
+          grand->set_color(RED);
+          node = grand;
         } else {
-          delete_case1(to_delete);
+          if (node == parent->left) {
+            node = parent;
+            RotateRight(node, root);
+            parent = node->parent();
+          }
+          parent->set_color(BLACK);
+          grand->set_color(RED);
+          RotateLeft(grand, root);
         }
       }
-      if (to_delete->is_left_child())
-        to_delete->parent->left = nullptr;
-      else
-        to_delete->parent->right = nullptr;
     }
-    DelNode(to_delete);
   }
 
-  void replace_node(node_pointer ptr, node_pointer child) {
-    if (ptr->parent != nullptr) {
-      child->parent = ptr->parent;
-      if (ptr->is_left_child())
-        ptr->parent->left = child;
-      else
-        ptr->parent->right = child;
-    } else {
-      child->parent = nullptr;
-      root_ = child;
-    }
+  static void RotateLeft(base_pointer node, base_pointer& root) {
+    base_pointer pivot = node->right;
+    node->right = pivot->left;
+    if (pivot->left != nullptr) pivot->left->set_parent(node);
+    pivot->set_parent(node->parent());
+    if (node == root)
+      root = pivot;
+    else if (node == node->parent()->left)
+      node->parent()->left = pivot;
+    else
+      node->parent()->right = pivot;
+    pivot->left = node;
+    node->set_parent(pivot);
+    Recount(node);
+    Recount(pivot);
+  }
+
+  static void RotateRight(base_pointer node, base_pointer& root) {
+    base_pointer pivot = node->left;
+    node->left = pivot->right;
+    if (pivot->right != nullptr) pivot->right->set_parent(node);
+    pivot->set_parent(node->parent());
+    if (node == root)
+      root = pivot;
+    else if (node == node->parent()->right)
+      node->parent()->right = pivot;
+    else
+      node->parent()->left = pivot;
+    pivot->right = node;
+    node->set_parent(pivot);
+    Recount(node);
+    Recount(pivot);
   }
 
-  void delete_one_child(node_pointer ptr) {
-    if (!ptr->right && !ptr->left) {
-      replace_node(ptr, nullptr);
-      if (ptr->color == BLACK) delete_case1(ptr->parent);
+  // Takes node out of the tree. Values never move: a node with two children
+  // first trades places with its successor, so other iterators stay valid.
+  base_pointer Detach(base_pointer node) {
+    if (node->left != nullptr && node->right != nullptr)
+      TakePlace(node, base_node::minimum(node->right));
+    Unlink(node);
+    return (node);
+  }
+
+  // Swaps the tree positions of node and next, its successor, colors and
+  // subtree sizes included. next has no left child, so node ends up with
+  // at most one child.
+  void TakePlace(base_pointer node, base_pointer next) {
+    base_pointer parent = node->parent();
+    base_pointer next_right = next->right;
+    if (node == Root())
+      Header()->set_parent(next);
+    else if (node == parent->left)
+      parent->left = next;
+    else
+      parent->right = next;
+    next->left = node->left;
+    next->left->set_parent(next);
+    if (next == node->right) {
+      next->right = node;
+      node->set_parent(next);
     } else {
-      node_pointer child = ptr->right ? ptr->right : ptr->left;
-      replace_node(ptr, child);
-      if (ptr->color == BLACK) {
-        if (child->color == RED)
-          child->color = BLACK;
-        else
-          delete_case1(child);
-      }
+      next->right = node->right;
+      next->right->set_parent(next);
+      next->parent()->left = node;
+      node->set_parent(next->parent());
     }
+    next->set_parent(parent);
+    node->left = nullptr;
+    node->right = next_right;
+    if (next_right != nullptr) next_right->set_parent(node);
+    color_type color = node->color();
+    node->set_color(next->color());
+    next->set_color(color);
+    if constexpr (kCounted)
+      std::swap(static_cast<node_pointer>(node)->count,
+                static_cast<node_pointer>(next)->count);
   }
 
-  void delete_case1(node_pointer ptr) {
-    if (ptr->parent) delete_case2(ptr);
+  void Unlink(base_pointer node) {
+    base_pointer child = node->left != nullptr ? node->left : node->right;
+    base_pointer parent = node->parent();
+    if (child != nullptr) child->set_parent(parent);
+    if (node == Root())
+      Header()->set_parent(child);
+    else if (node == parent->left)
+      parent->left = child;
+    else
+      parent->right = child;
+    if (node == Header()->left)
+      Header()->left = child ? base_node::minimum(child) : parent;
+    if (node == Header()->right)
+      Header()->right = child ? base_node::maximum(child) : parent;
+    RecountUp(parent, Header());
+    if (node->color() == BLACK) EraseFixup(child, parent);
   }
 
-  void delete_case2(node_pointer ptr) {
-    node_pointer b = ptr->brother();
-    if (b->color == RED) {
-      ptr->parent->color = RED;
-      b->color = BLACK;
-      if (ptr->is_left_child()) {
-        rotate_left(ptr->parent);
+  // child took the place of a removed black node under parent and is short
+  // one black node; it may be nullptr.
+  void EraseFixup(base_pointer child, base_pointer parent) {
+    base_pointer root = Root();
+    while (child != root && (child == nullptr || child->color() == BLACK)) {
+      if (child == parent->left) {
+        base_pointer brother = parent->right;
+        if (brother->color() == RED) {
+          brother->set_color(BLACK);
+          parent->set_color(RED);
+          RotateLeft(parent, root);
+          brother = parent->right;
+        }
+        if (IsBlack(brother->left) && IsBlack(brother->right)) {
+          brother->set_color(RED);
+          child = parent;
+          parent = parent->parent();
+        } else {
+          if (IsBlack(brother->right)) {
+            brother->left->set_color(BLACK);
+            brother->set_color(RED);
+            RotateRight(brother, root);
+            brother = parent->right;
+          }
+          brother->set_color(parent->color());
+          parent->set_color(BLACK);
+          if (brother->right != nullptr) brother->right->set_color(BLACK);
+          RotateLeft(parent, root);
+          break;
+        }
       } else {
-        rotate_right(ptr->parent);
+        base_pointer brother = parent->left;
+        if (brother->color() == RED) {
+          brother->set_color(BLACK);
+          parent->set_color(RED);
+          RotateRight(parent, root);
+          brother = parent->left;
+        }
+        if (IsBlack(brother->right) && IsBlack(brother->left)) {
+          brother->set_color(RED);
+          child = parent;
+          parent = parent->parent();
+        } else {
+          if (IsBlack(brother->left)) {
+            brother->right->set_color(BLACK);
+            brother->set_color(RED);
+            RotateLeft(brother, root);
+            brother = parent->left;
+          }
+          brother->set_color(parent->color());
+          parent->set_color(BLACK);
+          if (brother->left != nullptr) brother->left->set_color(BLACK);
+          RotateRight(parent, root);
+          break;
+        }
       }
     }
-    delete_case3(ptr);
+    if (child != nullptr) child->set_color(BLACK);
+    Header()->set_parent(root);
   }
 
-  void delete_case3(node_pointer ptr) {
-    node_pointer b = ptr->brother();
-    if (!b->has_only_one_child() &&
-        (ptr->parent->color == BLACK && b->color == BLACK) &&
-        ((b->left == nullptr && b->right == nullptr) ||
-         (b->left->color == BLACK && b->right->color == BLACK))) {
-      b->color = RED;
-      delete_case1(ptr->parent);
-    } else {
-      delete_case4(ptr);
+  static bool IsBlack(base_pointer node) {
+    return (node == nullptr || node->color() == BLACK);
+  }
+
+  enum Operation { kUnion, kIntersection, kDifference };
+
+  // Parallel operations whose smaller tree has at least this many elements
+  // recurse on several threads when the allocator is stateless.
+  static constexpr size_type kParallelJoinThreshold = 1 << 15;
+  static constexpr int kJoinSplitDepth = 3;
+
+  // Range erase cuts by split and join past this many elements, erase_if
+  // rebuilds once this fraction of the tree matched.
+  static constexpr size_type kBulkEraseMin = 32;
+  static constexpr size_type kRebuildDivisor = 8;
+
+  // Lookups in flight at once in find_batch and contains_batch.
+  static constexpr int kBatchWidth = 16;
+
+  // Deepest possible path in a red-black tree indexed by size_type.
+  static constexpr int kMaxDepth = 2 * std::numeric_limits<size_type>::digits;
+
+  // A detached subtree: its root is black (or absent) and has no parent.
+  struct Subtree {
+    base_pointer root;
+    int height;  // black nodes on every path down, the root included
+  };
+
+  struct Parts {
+    Subtree left;
+    base_pointer middle;
+    Subtree right;
+  };
+
+  void Combine(RBTree& other, Operation op, bool unique, bool parallel) {
+    if (this == &other) {
+      if (op == kDifference) clear();
+      return;
     }
+    if (!(alloc_ == other.alloc_)) {
+      RBTree copy(std::move(other), alloc_);
+      Combine(copy, op, unique, parallel);
+      return;
+    }
+    size_type total = size_ + other.size_;
+    bool smaller = other.size_ <= size_;
+    int depth = kJoinSplitDepth;
+    if constexpr (alloc_traits::is_always_equal::value) {
+      if (parallel && std::min(size_, other.size_) >= kParallelJoinThreshold)
+        depth = 0;
+    }
+    Subtree mine = Take();
+    Subtree theirs = other.Take();
+    size_type freed = 0;
+    Subtree result;
+    if (op == kUnion)
+      result = smaller ? Union(mine, theirs, true, unique, freed, depth)
+                       : Union(theirs, mine, false, unique, freed, depth);
+    else if (op == kIntersection)
+      result = smaller ? Intersect(mine, theirs, true, freed, depth)
+                       : Intersect(theirs, mine, false, freed, depth);
+    else
+      result = Subtract(mine, theirs, freed, depth);
+    Adopt(result.root, total - freed);
   }
 
-  void delete_case4(node_pointer ptr) {
-    node_pointer b = ptr->brother();
-    if (!b->has_only_one_child() && ptr->parent->color == RED &&
-        b->color == BLACK &&
-        ((b->left == nullptr && b->right == nullptr) ||
-         (b->left->color == BLACK && b->right->color == BLACK))) {
-      b->color = RED;
-      ptr->parent->color = BLACK;
-    } else {
-      delete_case5(ptr);
-    }
-  }
-
-  void delete_case5(node_pointer ptr) {
-    node_pointer b = ptr->brother();
-    if (!b->has_only_one_child() && b->color == BLACK) {
-      if (ptr->is_left_child() && b->right->color == BLACK &&
-          b->left->color == RED) {
-        b->color = RED;
-        b->left->color = BLACK;
-        rotate_right(b);
-      } else if (ptr->is_right_child() && b->left->color == BLACK &&
-                 b->right->color == RED) {
-        b->color = RED;
-        b->right->color = BLACK;
-        rotate_left(b);
+  // Detaches the whole tree, leaving it empty.
+  Subtree Take() {
+    Subtree tree{Root(), 0};
+    for (base_pointer node = tree.root; node; node = node->left)
+      tree.height += node->color() == BLACK;
+    if (tree.root != nullptr) tree.root->set_parent(nullptr);
+    Reset();
+    return tree;
+  }
+
+  void Adopt(base_pointer root, size_type count) {
+    if (root == nullptr) return;
+    Header()->set_parent(root);
+    root->set_parent(Header());
+    Header()->left = base_node::minimum(root);
+    Header()->right = base_node::maximum(root);
+    size_ = count;
+  }
+
+  // Detaches a child of a subtree whose black height is height + 1.
+  static Subtree Child(base_pointer node, int height) {
+    if (node != nullptr) {
+      node->set_parent(nullptr);
+      if (node->color() == RED) {
+        node->set_color(BLACK);
+        ++height;
       }
     }
-    delete_case6(ptr);
+    return Subtree{node, height};
+  }
+
+  static void Link(base_pointer node, base_pointer left, base_pointer right) {
+    node->left = left;
+    node->right = right;
+    if (left != nullptr) left->set_parent(node);
+    if (right != nullptr) right->set_parent(node);
   }
 
-  void delete_case6(node_pointer ptr) {
-    node_pointer b = ptr->brother();
-    b->color = ptr->parent->color;
-    ptr->parent->color = BLACK;
-    if (ptr->is_left_child()) {
-      b->right->color = BLACK;
-      rotate_left(ptr->parent);
+  // Joins left < middle < right. The shorter tree hangs off the spine of the
+  // taller one at the first black node of equal height, under middle colored
+  // red; at most the path back up needs repair.
+  static Subtree Join(Subtree left, base_pointer middle, Subtree right) {
+    middle->set_parent(nullptr);
+    if (left.height == right.height) {
+      middle->set_color(BLACK);
+      Link(middle, left.root, right.root);
+      Recount(middle);
+      return Subtree{middle, left.height + 1};
+    }
+    Subtree tall = left.height > right.height ? left : right;
+    base_pointer parent = nullptr;
+    base_pointer node = tall.root;
+    int height = tall.height;
+    if (left.height > right.height) {
+      while (!IsBlack(node) || height != right.height) {
+        height -= node->color() == BLACK;
+        parent = node;
+        node = node->right;
+      }
+      Link(middle, node, right.root);
+      parent->right = middle;
     } else {
-      b->left->color = BLACK;
-      rotate_right(ptr->parent);
+      while (!IsBlack(node) || height != left.height) {
+        height -= node->color() == BLACK;
+        parent = node;
+        node = node->left;
+      }
+      Link(middle, left.root, node);
+      parent->left = middle;
     }
+    middle->set_parent(parent);
+    middle->set_color(RED);
+    RecountUp(middle, nullptr);
+    InsertFixup(middle, tall.root);
+    if (tall.root->color() == RED) {
+      tall.root->set_color(BLACK);
+      ++tall.height;
+    }
+    return tall;
   }
 
-  void swap(RBTree& other) {
-    std::swap(root_, other.root_);
-    std::swap(size_, other.size_);
-    std::swap(comp_, other.comp_);
-    std::swap(alloc_, other.alloc_);
+  // Joins left < right.
+  static Subtree Join(Subtree left, Subtree right) {
+    if (left.root == nullptr) return right;
+    if (right.root == nullptr) return left;
+    std::pair<Subtree, base_pointer> last = SplitLast(left);
+    return Join(last.first, last.second, right);
   }
 
-  void print() {
-    iter first = iter(start());
-    iter last = iter(edge());
-    for (size_type i = 0; i < size_; ++i) {
-      std::cout << "key: " << (*first).first << " value: " << (*first).second
-                << " color: " << first.operator->()->color << std::endl;
-      ++first;
-    }
+  static std::pair<Subtree, base_pointer> SplitLast(Subtree tree) {
+    base_pointer node = tree.root;
+    Subtree left = Child(node->left, tree.height - 1);
+    Subtree right = Child(node->right, tree.height - 1);
+    if (right.root == nullptr) return std::make_pair(left, node);
+    std::pair<Subtree, base_pointer> last = SplitLast(right);
+    return std::make_pair(Join(left, node, last.first), last.second);
   }
 
-  void print_mult() {
-    iter first = iter(start());
-    iter last = iter(edge());
-    for (size_type i = 0; i < size_; ++i) {
-      std::cout << "value: " << *first
-                << " color: " << first.operator->()->color << std::endl;
-      ++first;
+  // Splits around key. With unique set an equivalent node is returned as
+  // middle; otherwise equivalent nodes go to the right part.
+  Parts Split(Subtree tree, const_reference key, bool unique) const {
+    if (tree.root == nullptr) return Parts{tree, nullptr, tree};
+    base_pointer node = tree.root;
+    Subtree left = Child(node->left, tree.height - 1);
+    Subtree right = Child(node->right, tree.height - 1);
+    bool goes_right = unique ? comp_(key, Value(node))
+                             : !comp_(Value(node), key);
+    if (goes_right) {
+      Parts parts = Split(left, key, unique);
+      parts.right = Join(parts.right, node, right);
+      return parts;
     }
+    if (!unique || comp_(Value(node), key)) {
+      Parts parts = Split(right, key, unique);
+      parts.left = Join(left, node, parts.left);
+      return parts;
+    }
+    return Parts{left, node, right};
   }
 
-  bool is_balanced() {
-    int maxh, minh;
-    return IsBalancedUtil(root_, maxh, minh);
+  // Splits around target, one of the nodes of tree, by position instead of
+  // by key, as equivalent keys of a multiset need.
+  static Parts SplitAt(Subtree tree, base_pointer target) {
+    bool path[kMaxDepth];
+    int depth = 0;
+    for (base_pointer node = target; node != tree.root; node = node->parent())
+      path[depth++] = node == node->parent()->left;
+    return (SplitPath(tree, target, path, depth));
   }
 
-  iter lower_bound(const_reference val) {
-    node_pointer curr = root_;
-    node_pointer result = nullptr;
-    while (curr != nullptr) {
-      if (!comp_(curr->value, val)) {
-        result = curr;
-        curr = curr->left;
-      } else {
-        curr = curr->right;
-      }
+  // path[depth - 1] tells whether target lies left of the root of tree.
+  static Parts SplitPath(Subtree tree, base_pointer target, const bool* path,
+                         int depth) {
+    base_pointer node = tree.root;
+    Subtree left = Child(node->left, tree.height - 1);
+    Subtree right = Child(node->right, tree.height - 1);
+    if (node == target) return Parts{left, node, right};
+    if (path[depth - 1]) {
+      Parts parts = SplitPath(left, target, path, depth - 1);
+      parts.right = Join(parts.right, node, right);
+      return parts;
     }
-    return (result ? iter(result) : edge());
+    Parts parts = SplitPath(right, target, path, depth - 1);
+    parts.left = Join(left, node, parts.left);
+    return parts;
   }
 
-  iter upper_bound(const_reference val) {
-    node_pointer curr = root_;
-    node_pointer result = nullptr;
-    while (curr != nullptr) {
-      if (comp_(val, curr->value)) {
-        result = curr;
-        curr = curr->left;
+  // Removes [first, stop) with two splits and a join; stop may be the
+  // header.
+  size_type Cut(base_pointer first, base_pointer stop) {
+    size_type count = size_;
+    Parts head = SplitAt(Take(), first);
+    Subtree kept = head.left;
+    size_type freed = 1;
+    if (stop == Header()) {
+      freed += ClearTree(head.right.root, alloc_);
+    } else {
+      Parts tail = SplitAt(head.right, stop);
+      freed += ClearTree(tail.left.root, alloc_);
+      kept = Join(head.left, stop, tail.right);
+    }
+    FreeNode(first, alloc_);
+    Adopt(kept.root, count - freed);
+    return (freed);
+  }
+
+  // Finishes erase_if from node on: every node is visited in order and
+  // chained through its left link, which the walk no longer reads, onto
+  // the survivors or the victims. Survivors are rebuilt as a balanced tree,
+  // victims freed. Should pred throw, the rest is kept and the exception
+  // passed on once the tree is whole again.
+  template <typename Pred>
+  size_type Rebuild(base_pointer from, Pred& pred) {
+    base_node kept;
+    base_pointer tail = &kept;
+    base_pointer victims = nullptr;
+    size_type count = 0;
+    size_type erased = 0;
+    bool deciding = false;
+    std::exception_ptr error;
+    for (base_pointer node = Header()->left; node != Header();) {
+      base_pointer next = node->forward();
+      deciding = deciding || node == from;
+      bool drop = false;
+      if (deciding && !error) {
+        try {
+          drop = pred(static_cast<const_reference>(Value(node)));
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+      if (drop) {
+        node->left = victims;
+        victims = node;
+        ++erased;
       } else {
-        curr = curr->right;
+        tail->left = node;
+        tail = node;
+        ++count;
       }
+      node = next;
+    }
+    base_pointer node = kept.left;
+    for (size_type i = 0; i < count; ++i, node = node->left)
+      node->right = node->left;
+    while (victims != nullptr) {
+      base_pointer next = victims->left;
+      FreeNode(victims, alloc_);
+      victims = next;
     }
-    return (result ? iter(result) : edge());
+    BuildFrom(kept.left, count);
+    if (error) std::rethrow_exception(error);
+    return (erased);
   }
 
-  std::pair<iter, iter> equal_range(const_reference val) {
-    iter lower = lower_bound(val);
-    iter upper = upper_bound(val);
-    return std::make_pair(lower, upper);
+  // Runs both halves, the left one on another thread while depth is below
+  // kJoinSplitDepth.
+  template <typename Recurse>
+  static std::pair<Subtree, Subtree> Both(Recurse recurse, size_type& freed,
+                                          int depth) {
+    if (depth >= kJoinSplitDepth)
+      return std::make_pair(recurse(true, freed), recurse(false, freed));
+    size_type left_freed = 0;
+    std::future<Subtree> left = std::async(
+        std::launch::async, [&] { return recurse(true, left_freed); });
+    Subtree right = recurse(false, freed);
+    Subtree result = left.get();
+    freed += left_freed;
+    return std::make_pair(result, right);
   }
 
- private:
-  allocator_type alloc_;
-  compare_type comp_;
-  node_pointer root_;
-  size_type size_;
+  // Splits split_side by the root of each subtree of exposed, which should
+  // be the smaller tree; split_wins picks the node kept on a tie.
+  Subtree Union(Subtree split_side, Subtree exposed, bool split_wins,
+                bool unique, size_type& freed, int depth) {
+    if (split_side.root == nullptr) return exposed;
+    if (exposed.root == nullptr) return split_side;
+    base_pointer node = exposed.root;
+    Subtree left = Child(node->left, exposed.height - 1);
+    Subtree right = Child(node->right, exposed.height - 1);
+    Parts parts = Split(split_side, Value(node), unique);
+    std::pair<Subtree, Subtree> halves = Both(
+        [&](bool first, size_type& count) {
+          return first ? Union(parts.left, left, split_wins, unique, count,
+                               depth + 1)
+                       : Union(parts.right, right, split_wins, unique, count,
+                               depth + 1);
+        },
+        freed, depth);
+    if (parts.middle != nullptr) {
+      if (split_wins) std::swap(node, parts.middle);
+      FreeNode(parts.middle, alloc_);
+      ++freed;
+    }
+    return Join(halves.first, node, halves.second);
+  }
 
-  node_pointer NewNode(value_type const& val, color_type const& color = RED) {
-    node_pointer ptr = alloc_.allocate(1);
-    alloc_.construct(ptr, node_type(val, color));
-    ++size_;
-    return ptr;
-  };
+  Subtree Intersect(Subtree split_side, Subtree exposed, bool split_wins,
+                    size_type& freed, int depth) {
+    if (split_side.root == nullptr || exposed.root == nullptr) {
+      freed += ClearTree(split_side.root, alloc_);
+      freed += ClearTree(exposed.root, alloc_);
+      return Subtree{nullptr, 0};
+    }
+    base_pointer node = exposed.root;
+    Subtree left = Child(node->left, exposed.height - 1);
+    Subtree right = Child(node->right, exposed.height - 1);
+    Parts parts = Split(split_side, Value(node), true);
+    std::pair<Subtree, Subtree> halves = Both(
+        [&](bool first, size_type& count) {
+          return first ? Intersect(parts.left, left, split_wins, count,
+                                   depth + 1)
+                       : Intersect(parts.right, right, split_wins, count,
+                                   depth + 1);
+        },
+        freed, depth);
+    if (parts.middle == nullptr) {
+      FreeNode(node, alloc_);
+      ++freed;
+      return Join(halves.first, halves.second);
+    }
+    if (split_wins) std::swap(node, parts.middle);
+    FreeNode(parts.middle, alloc_);
+    ++freed;
+    return Join(halves.first, node, halves.second);
+  }
 
-  void DelNode(node_pointer ptr) {
-    alloc_.destroy(ptr);
-    alloc_.deallocate(ptr, 1);
-    --size_;
-  };
+  // Removes the elements of removed from kept.
+  Subtree Subtract(Subtree kept, Subtree removed, size_type& freed,
+                   int depth) {
+    if (removed.root == nullptr) return kept;
+    if (kept.root == nullptr) {
+      freed += ClearTree(removed.root, alloc_);
+      return kept;
+    }
+    base_pointer node = removed.root;
+    Subtree left = Child(node->left, removed.height - 1);
+    Subtree right = Child(node->right, removed.height - 1);
+    Parts parts = Split(kept, Value(node), true);
+    std::pair<Subtree, Subtree> halves = Both(
+        [&](bool first, size_type& count) {
+          return first ? Subtract(parts.left, left, count, depth + 1)
+                       : Subtract(parts.right, right, count, depth + 1);
+        },
+        freed, depth);
+    FreeNode(node, alloc_);
+    ++freed;
+    if (parts.middle != nullptr) {
+      FreeNode(parts.middle, alloc_);
+      ++freed;
+    }
+    return Join(halves.first, halves.second);
+  }
 
-  void ClearTree(node_pointer ptr) {
-    if (ptr == nullptr) return;
-    ClearTree(ptr->left);
-    ClearTree(ptr->right);
-    alloc_.destroy(ptr);
-    alloc_.deallocate(ptr, 1);
-  };
+  // Makes a balanced tree of the count nodes chained in order through their
+  // right links.
+  void BuildFrom(base_pointer chain, size_type count) {
+    Reset();
+    if (!count) return;
+    int red_depth = 0;
+    while ((size_type(2) << red_depth) - 1 <= count) ++red_depth;
+    Header()->set_parent(BuildSorted(chain, count, 0, red_depth));
+    Header()->parent()->set_parent(Header());
+    Header()->left = base_node::minimum(Header()->parent());
+    Header()->right = base_node::maximum(Header()->parent());
+    size_ = count;
+  }
 
-  bool IsBalancedUtil(node_pointer n, int& maxh, int& minh) {
-    if (n == nullptr) {
-      maxh = minh = 0;
-      return true;
-    }
-    int lmxh, lmnh;
-    int rmxh, rmnh;
+  // Turns the next n nodes of the chain into a subtree whose halves differ
+  // in size by at most one. Every level above red_depth is full, so making
+  // the nodes below it red gives equal black heights.
+  static base_pointer BuildSorted(base_pointer& chain, size_type n, int depth,
+                                  int red_depth) {
+    if (n == 0) return nullptr;
+    size_type left_count = (n - 1) / 2;
+    base_pointer left = BuildSorted(chain, left_count, depth + 1, red_depth);
+    base_pointer node = chain;
+    chain = chain->right;
+    node->set_color(depth >= red_depth ? RED : BLACK);
+    node->left = left;
+    if (left != nullptr) left->set_parent(node);
+    node->right =
+        BuildSorted(chain, n - 1 - left_count, depth + 1, red_depth);
+    if (node->right != nullptr) node->right->set_parent(node);
+    Recount(node);
+    return node;
+  }
 
-    if (IsBalancedUtil(n->left, lmxh, lmnh) == false) return false;
+  // Frees a subtree without recursion: left children are rotated up until
+  // the node at hand has none, then it is freed and its right child is next.
+  static size_type ClearTree(base_pointer node, allocator_type& alloc) {
+    size_type count = 0;
+    while (node != nullptr) {
+      if (node->left != nullptr) {
+        base_pointer left = node->left;
+        node->left = left->right;
+        left->right = node;
+        node = left;
+      } else {
+        base_pointer right = node->right;
+        FreeNode(node, alloc);
+        node = right;
+        ++count;
+      }
+    }
+    return count;
+  };
 
-    if (IsBalancedUtil(n->right, rmxh, rmnh) == false) return false;
+  void CopyFrom(const RBTree& other, bool parallel = false) {
+    if (!other.size()) return;
+    Header()->set_parent(
+        CopyTree(other.Root(), Header(), other.size(), parallel));
+    Header()->left = base_node::minimum(Header()->parent());
+    Header()->right = base_node::maximum(Header()->parent());
+    size_ = other.size_;
+  }
 
-    maxh = fmax(lmxh, rmxh) + 1;
-    minh = fmin(lmnh, rmnh) + 1;
+  // A parallel copy of a large tree runs on several threads when the
+  // allocator is stateless, and so allocates from the shared heap.
+  base_pointer CopyTree(base_pointer src, base_pointer parent,
+                        size_type count, bool parallel) {
+    if constexpr (alloc_traits::is_always_equal::value) {
+      if (parallel && count >= kParallelCopyThreshold)
+        return ParallelCopy(src, parent);
+    }
+    return CopySubtree(src, parent, alloc_);
+  }
 
-    if (maxh <= 2 * minh) return true;
+  // Pre-order walk over the parent links of both trees; each copied node
+  // is allocated once and nothing is kept on the stack.
+  static base_pointer CopySubtree(base_pointer src, base_pointer parent,
+                                  allocator_type& alloc) {
+    base_pointer const top = src;
+    base_pointer root = MakeNode(alloc, src->color(), Value(src));
+    CopyCount(root, src);
+    root->set_parent(parent);
+    base_pointer dst = root;
+    try {
+      while (true) {
+        if (src->left != nullptr && dst->left == nullptr) {
+          src = src->left;
+          dst->left = MakeNode(alloc, src->color(), Value(src));
+          CopyCount(dst->left, src);
+          dst->left->set_parent(dst);
+          dst = dst->left;
+        } else if (src->right != nullptr && dst->right == nullptr) {
+          src = src->right;
+          dst->right = MakeNode(alloc, src->color(), Value(src));
+          CopyCount(dst->right, src);
+          dst->right->set_parent(dst);
+          dst = dst->right;
+        } else if (src == top) {
+          break;
+        } else {
+          src = src->parent();
+          dst = dst->parent();
+        }
+      }
+    } catch (...) {
+      ClearTree(root, alloc);
+      throw;
+    }
+    return root;
+  }
 
-    return false;
+  // Subtrees hanging below the top kCopySplitDepth levels.
+  struct CopyTask {
+    base_pointer src;
+    base_pointer parent;
+    typename base_node::link_type* slot;
   };
 
-  node_pointer CopyTree(node_pointer src_node, node_pointer parent) {
-    if (src_node == nullptr) return nullptr;
-    node_pointer new_node = NewNode(src_node->value, src_node->color);
-    new_node->parent = parent;
-    new_node->left = CopyTree(src_node->left, new_node);
-    new_node->right = CopyTree(src_node->right, new_node);
-    return new_node;
-  };
+  static constexpr int kCopySplitDepth = 3;
+
+  base_pointer ParallelCopy(base_pointer src, base_pointer parent) {
+    CopyTask tasks[1 << kCopySplitDepth];
+    int count = 0;
+    base_pointer root =
+        CopyTop(src, parent, kCopySplitDepth - 1, tasks, count);
+    std::future<base_pointer> results[1 << kCopySplitDepth];
+    for (int i = 0; i < count; ++i) {
+      results[i] = std::async(std::launch::async, [task = tasks[i], this] {
+        allocator_type alloc(alloc_);
+        return CopySubtree(task.src, task.parent, alloc);
+      });
+    }
+    std::exception_ptr error;
+    for (int i = 0; i < count; ++i) {
+      try {
+        *tasks[i].slot = results[i].get();
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    if (error) {
+      ClearTree(root, alloc_);
+      std::rethrow_exception(error);
+    }
+    return root;
+  }
+
+  // Copies depth + 1 levels of src and records the child slots below them
+  // in tasks.
+  base_pointer CopyTop(base_pointer src, base_pointer parent, int depth,
+                       CopyTask* tasks, int& count) {
+    base_pointer node = MakeNode(alloc_, src->color(), Value(src));
+    CopyCount(node, src);
+    node->set_parent(parent);
+    try {
+      if (src->left != nullptr) {
+        if (depth > 0)
+          node->left = CopyTop(src->left, node, depth - 1, tasks, count);
+        else
+          tasks[count++] = CopyTask{src->left, node, &node->left};
+      }
+      if (src->right != nullptr) {
+        if (depth > 0)
+          node->right = CopyTop(src->right, node, depth - 1, tasks, count);
+        else
+          tasks[count++] = CopyTask{src->right, node, &node->right};
+      }
+    } catch (...) {
+      ClearTree(node, alloc_);
+      throw;
+    }
+    return node;
+  }
 };
 
 }  // namespace ns
@@ -0,0 +1,410 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+namespace ns {
+
+// Pool of same-sized blocks carved out of slabs. Freed blocks go onto an
+// intrusive free list and are handed out again first, so node churn never
+// reaches malloc once the pool is warm. Slabs are carved lazily; with
+// prefault set every new slab is touched up front instead. Not thread safe.
+class NodePool {
+ public:
+  static constexpr std::size_t kDefaultSlabBlocks = 256;
+
+  NodePool(std::size_t block_size, std::size_t slab_blocks = kDefaultSlabBlocks,
+           bool prefault = false)
+      : block_size_(block_size_for(block_size)),
+        slab_blocks_(slab_blocks ? slab_blocks : 1),
+        prefault_(prefault),
+        slabs_(nullptr),
+        free_(nullptr),
+        carve_(nullptr),
+        carve_end_(nullptr),
+        available_(0),
+        slab_count_(0) {}
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+  ~NodePool() {
+    while (slabs_ != nullptr) {
+      Slab* next = slabs_->next;
+      ::operator delete(slabs_);
+      slabs_ = next;
+    }
+  }
+
+  void* allocate() {
+    if (free_ == nullptr && carve_ == carve_end_) NewSlab(slab_blocks_);
+    --available_;
+    if (free_ != nullptr) {
+      Block* block = free_;
+      free_ = block->next;
+      return block;
+    }
+    void* ptr = carve_;
+    carve_ += block_size_;
+    return ptr;
+  }
+
+  void deallocate(void* ptr) {
+    Block* block = static_cast<Block*>(ptr);
+    block->next = free_;
+    free_ = block;
+    ++available_;
+  }
+
+  // Makes sure n blocks can be handed out without another slab allocation.
+  void reserve(std::size_t n) {
+    if (n > available_) NewSlab(n - available_);
+  }
+
+  static std::size_t block_size_for(std::size_t size) {
+    const std::size_t align = alignof(std::max_align_t);
+    if (size < sizeof(void*)) size = sizeof(void*);
+    return (size + align - 1) / align * align;
+  }
+
+  std::size_t block_size() const { return block_size_; }
+  std::size_t slab_blocks() const { return slab_blocks_; }
+  bool prefault() const { return prefault_; }
+  std::size_t available() const { return available_; }
+  std::size_t slab_count() const { return slab_count_; }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  struct alignas(std::max_align_t) Slab {
+    Slab* next;
+  };
+
+  std::size_t block_size_;
+  std::size_t slab_blocks_;
+  bool prefault_;
+  Slab* slabs_;
+  Block* free_;
+  char* carve_;
+  char* carve_end_;
+  std::size_t available_;
+  std::size_t slab_count_;
+
+  void NewSlab(std::size_t blocks) {
+    if (blocks < slab_blocks_) blocks = slab_blocks_;
+    while (carve_ != carve_end_) {
+      Block* block = reinterpret_cast<Block*>(carve_);
+      block->next = free_;
+      free_ = block;
+      carve_ += block_size_;
+    }
+    std::size_t bytes = blocks * block_size_;
+    Slab* slab = static_cast<Slab*>(::operator new(sizeof(Slab) + bytes));
+    slab->next = slabs_;
+    slabs_ = slab;
+    carve_ = reinterpret_cast<char*>(slab + 1);
+    carve_end_ = carve_ + bytes;
+    if (prefault_) std::memset(carve_, 0, bytes);
+    available_ += blocks;
+    ++slab_count_;
+  }
+};
+
+// NodePools with common slab settings, one per block size, created on
+// first use. Pools never move once created.
+class NodePoolSet {
+ public:
+  NodePoolSet(std::size_t slab_blocks, bool prefault)
+      : slab_blocks_(slab_blocks), prefault_(prefault) {}
+  NodePoolSet(const NodePoolSet&) = delete;
+  NodePoolSet& operator=(const NodePoolSet&) = delete;
+
+  NodePool& pool_for(std::size_t size) {
+    std::size_t idx =
+        NodePool::block_size_for(size) / alignof(std::max_align_t) - 1;
+    if (idx >= pools_.size()) pools_.resize(idx + 1);
+    if (!pools_[idx])
+      pools_[idx].reset(new NodePool(size, slab_blocks_, prefault_));
+    return *pools_[idx];
+  }
+
+  std::size_t slab_blocks() const { return slab_blocks_; }
+  bool prefault() const { return prefault_; }
+
+ private:
+  std::size_t slab_blocks_;
+  bool prefault_;
+  std::vector<std::unique_ptr<NodePool>> pools_;
+};
+
+// Serves single-object allocations (the containers' nodes) from a NodePool
+// and falls back to ::operator new for arrays. Copies and rebound copies
+// share one NodePoolSet and compare equal; each value type draws from the
+// pool of its block size. Propagates like LinearAllocator.
+template <typename T>
+class PoolAllocator {
+ public:
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "over-aligned types are not supported");
+
+  PoolAllocator() : PoolAllocator(NodePool::kDefaultSlabBlocks){};
+  explicit PoolAllocator(size_type slab_blocks, bool prefault = false)
+      : pools_(std::make_shared<NodePoolSet>(slab_blocks, prefault)),
+        pool_(&pools_->pool_for(sizeof(T))){};
+  PoolAllocator(const PoolAllocator&) = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other)
+      : pools_(other.pools()), pool_(&pools_->pool_for(sizeof(T))){};
+  ~PoolAllocator(){};
+
+  PoolAllocator& operator=(const PoolAllocator&) = default;
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+
+  pointer allocate(size_type n) {
+    if (n == 1) return static_cast<pointer>(pool_->allocate());
+    if (n > max_size()) throw std::bad_array_new_length();
+    return static_cast<pointer>(::operator new(n * sizeof(value_type)));
+  }
+
+  void deallocate(void* ptr, size_type n) {
+    if (n == 1)
+      pool_->deallocate(ptr);
+    else
+      ::operator delete(ptr);
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  size_type max_size() const noexcept {
+    return std::numeric_limits<size_type>::max() / sizeof(value_type);
+  }
+
+  void reserve(size_type n) { pool_->reserve(n); }
+
+  NodePool* pool() const { return pool_; }
+
+  const std::shared_ptr<NodePoolSet>& pools() const { return pools_; }
+
+  template <typename U>
+  struct rebind {
+    using other = PoolAllocator<U>;
+  };
+
+ private:
+  std::shared_ptr<NodePoolSet> pools_;
+  NodePool* pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) {
+  return lhs.pools() == rhs.pools();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) {
+  return !(lhs == rhs);
+}
+
+// Process-wide arena behind IndexPoolAllocator. One range of address space
+// is reserved on first use and backed by the OS as it is touched, so every
+// block can be named by a 32-bit index: its offset in kUnit-byte units, 0
+// standing for nullptr. Freed blocks go onto a free list per size and are
+// handed out again first; the range itself is never given back. Thread
+// safe.
+class IndexArena {
+ public:
+  static constexpr std::size_t kUnit = 8;
+  // Keeps indices below 2^31, so a 32-bit word holding one has a bit to
+  // spare.
+  static constexpr std::size_t kMaxBytes = std::size_t(1) << 34;
+
+  static void* address(std::uint32_t index) {
+    return index ? base_ + std::size_t(index) * kUnit : nullptr;
+  }
+
+  static std::uint32_t index(const void* ptr) {
+    if (ptr == nullptr) return 0;
+    return static_cast<std::uint32_t>(
+        (static_cast<const char*>(ptr) - base_) / kUnit);
+  }
+
+  static void* allocate(std::size_t size) {
+    std::size_t units = units_for(size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (base_ == nullptr) Reserve();
+    if (units < free_.size() && free_[units] != nullptr) {
+      Block* block = free_[units];
+      free_[units] = block->next;
+      in_use_ += units * kUnit;
+      return block;
+    }
+    if (units > capacity_ - top_) throw std::bad_alloc();
+    void* ptr = base_ + top_ * kUnit;
+    top_ += units;
+    in_use_ += units * kUnit;
+    return ptr;
+  }
+
+  static void deallocate(void* ptr, std::size_t size) {
+    std::size_t units = units_for(size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (units >= free_.size()) free_.resize(units + 1);
+    Block* block = static_cast<Block*>(ptr);
+    block->next = free_[units];
+    free_[units] = block;
+    in_use_ -= units * kUnit;
+  }
+
+  // Bytes handed out and not given back yet.
+  static std::size_t in_use() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_use_;
+  }
+
+  static std::size_t block_size_for(std::size_t size) {
+    return units_for(size) * kUnit;
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  // Below this the reservation gives up and allocation fails.
+  static constexpr std::size_t kMinBytes = std::size_t(1) << 24;
+
+  static inline std::mutex mutex_;
+  static inline char* base_ = nullptr;
+  static inline std::size_t top_ = 1;
+  static inline std::size_t capacity_ = 0;
+  static inline std::size_t in_use_ = 0;
+  static inline std::vector<Block*> free_;
+
+  static std::size_t units_for(std::size_t size) {
+    if (size < sizeof(Block)) size = sizeof(Block);
+    return (size + kUnit - 1) / kUnit;
+  }
+
+  // Takes the largest range the system grants, halving down from
+  // kMaxBytes.
+  static void Reserve() {
+    for (std::size_t bytes = kMaxBytes; bytes >= kMinBytes; bytes /= 2) {
+#if defined(__unix__) || defined(__APPLE__)
+      void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (ptr == MAP_FAILED) continue;
+#else
+      void* ptr = std::malloc(bytes);
+      if (ptr == nullptr) continue;
+#endif
+      base_ = static_cast<char*>(ptr);
+      capacity_ = bytes / kUnit;
+      return;
+    }
+    throw std::bad_alloc();
+  }
+};
+
+// Allocates from the IndexArena. Trees on this allocator link their nodes
+// by 32-bit arena index instead of by pointer, which roughly halves the
+// per-node overhead for small keys. Stateless: all instances compare equal.
+template <typename T>
+class IndexPoolAllocator {
+ public:
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using is_always_equal = std::true_type;
+  using arena_type = IndexArena;
+
+  static_assert(alignof(T) <= IndexArena::kUnit,
+                "over-aligned types are not supported");
+
+  IndexPoolAllocator(){};
+  IndexPoolAllocator(const IndexPoolAllocator&) = default;
+  template <typename U>
+  IndexPoolAllocator(const IndexPoolAllocator<U>&){};
+  ~IndexPoolAllocator(){};
+
+  IndexPoolAllocator& operator=(const IndexPoolAllocator&) = default;
+
+  pointer allocate(size_type n) {
+    if (n > max_size()) throw std::bad_array_new_length();
+    return static_cast<pointer>(IndexArena::allocate(n * sizeof(value_type)));
+  }
+
+  void deallocate(void* ptr, size_type n) {
+    IndexArena::deallocate(ptr, n * sizeof(value_type));
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  size_type max_size() const noexcept {
+    return IndexArena::kMaxBytes / sizeof(value_type);
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = IndexPoolAllocator<U>;
+  };
+};
+
+template <typename T, typename U>
+bool operator==(const IndexPoolAllocator<T>&, const IndexPoolAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const IndexPoolAllocator<T>&, const IndexPoolAllocator<U>&) {
+  return false;
+}
+
+}  // namespace ns
+
+#endif  // POOL_H_
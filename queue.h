@@ -1,6 +1,9 @@
 #ifndef QUEUE_H_
 #define QUEUE_H_
 
+#include <memory>
+#include <type_traits>
+
 #include "vector.h"
 
 namespace ns {
@@ -25,21 +28,36 @@ class queue {
 
   queue(const queue& q) : cont_(q.cont_) {}
 
-  queue(queue&& q) { std::swap(cont_, q.cont_); }
+  queue(queue&& q) : cont_(std::move(q.cont_)) {}
+
+  // Allocator-extended constructors.
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  explicit queue(const Alloc& alloc) : cont_(alloc) {}
+
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  queue(const queue& q, const Alloc& alloc) : cont_(q.cont_, alloc) {}
+
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  queue(queue&& q, const Alloc& alloc) : cont_(std::move(q.cont_), alloc) {}
 
   ~queue() {}
 
   queue& operator=(const queue& q) {
     if (this != &q) {
-      cont_.clear();
-      cont_.Assign(q.begin(), q.end());
+      cont_ = q.cont_;
     }
     return (*this);
   }
 
   queue& operator=(queue&& q) {
     if (this != &q) {
-      *this = std::move(q);
+      cont_ = std::move(q.cont_);
     }
     return (*this);
   }
@@ -7,8 +7,10 @@
 
 namespace ns {
 
+// TreePolicy = ns::CountedTree keeps subtree sizes for nth() and rank().
 template <typename Key, typename Compare = std::less<Key>,
-          typename Allocator = ns::LinearAllocator<Key>>
+          typename Allocator = ns::allocator<Key>,
+          typename TreePolicy = ns::PlainTree>
 class set {
  public:
   using key_type = Key;
@@ -17,7 +19,7 @@ class set {
   using const_pointer = const value_type*;
   using reference = value_type&;
   using const_reference = const value_type&;
-  using node_type = ns::RBTnode<value_type>;
+  using node_type = ns::RBTnode<value_type, ns::node_links_t<Allocator>>;
   using node_pointer = node_type*;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
@@ -25,7 +27,12 @@ class set {
   using iter = ns::BDIter<value_type, node_type>;
   using const_iter = ns::BDIter<const value_type, node_type>;
   using allocator_type = Allocator;
-  using tree_type = ns::RBTree<value_type, compare_type, allocator_type>;
+  using tree_type =
+      ns::RBTree<value_type, compare_type, allocator_type, TreePolicy>;
+  using node_handle =
+      ns::NodeHandle<typename tree_type::node_type,
+                     typename tree_type::allocator_type>;
+  using insert_return_type = ns::InsertReturn<iter, node_handle>;
 
   set(const allocator_type& alloc = allocator_type(),
       const compare_type& comp = compare_type())
@@ -42,12 +49,39 @@ class set {
     for (; first != last; first++) insert(*first);
   };
 
+  // Linear-time construction from input sorted by comp; repeated keys are
+  // dropped.
+  template <typename InputIt>
+  set(ns::sorted_unique_t, InputIt first, InputIt last,
+      const allocator_type& alloc = allocator_type(),
+      const compare_type& comp = compare_type())
+      : tree_(alloc, comp) {
+    tree_.assign_sorted(first, last, true);
+  };
+
+  set(ns::sorted_unique_t, std::initializer_list<value_type> list,
+      const allocator_type& alloc = allocator_type(),
+      const compare_type& comp = compare_type())
+      : set(ns::sorted_unique, list.begin(), list.end(), alloc, comp){};
+
+  template <typename InputIt>
+  static set from_sorted(InputIt first, InputIt last,
+                         const allocator_type& alloc = allocator_type(),
+                         const compare_type& comp = compare_type()) {
+    return (set(ns::sorted_unique, first, last, alloc, comp));
+  }
+
   set(const set& s) : tree_(s.tree_){};
 
-  set(set&& s) : tree_() {
-    if (s.empty()) return;
-    swap(s);
-  };
+  set(const set& s, const allocator_type& alloc) : tree_(s.tree_, alloc){};
+
+  // Copies a large set on several threads; see ns::parallel_t.
+  set(ns::parallel_t, const set& s) : tree_(ns::parallel, s.tree_){};
+
+  set(set&& s) : tree_(std::move(s.tree_)){};
+
+  set(set&& s, const allocator_type& alloc)
+      : tree_(std::move(s.tree_), alloc){};
 
   ~set(){};
 
@@ -59,28 +93,32 @@ class set {
   }
 
   set& operator=(set&& s) {
-    if (this == &s) return *this;
-    clear();
-    swap(s);
+    tree_ = std::move(s.tree_);
     return (*this);
   }
 
+  allocator_type get_allocator() const {
+    return (allocator_type(tree_.get_allocator()));
+  }
+
   size_type size() const { return (tree_.size()); }
 
   size_type max_size() const {
     return (std::numeric_limits<size_type>::max() / (20 * sizeof(value_type)));
   }
 
-  iter begin() { return (size() ? tree_.start() : nullptr); }
+  iter begin() { return (tree_.begin()); }
 
-  const_iter cbegin() const {
-    return (size() ? const_iter(tree_.cstart()) : nullptr);
-  }
+  const_iter cbegin() const { return (tree_.cbegin()); }
 
-  iter end() { return (size() ? tree_.edge() : nullptr); }
+  iter end() { return (tree_.end()); }
 
-  const_iter cend() const {
-    return (size() ? const_iter(tree_.cedge()) : nullptr);
+  const_iter cend() const { return (tree_.cend()); }
+
+  // Calls f(key) on every element in order and returns f.
+  template <typename F>
+  F for_each(F f) const {
+    return (tree_.for_each(std::move(f)));
   }
 
   bool empty() const { return (!size()); };
@@ -89,6 +127,30 @@ class set {
     return (tree_.insert(val));
   }
 
+  std::pair<iter, bool> insert(value_type&& val) {
+    return (tree_.insert(std::move(val)));
+  }
+
+  // Builds the element in place; it is destroyed again if the key is taken.
+  template <typename... Args>
+  std::pair<iter, bool> emplace(Args&&... args) {
+    return (tree_.emplace(std::forward<Args>(args)...));
+  }
+
+  // Amortized O(1) when val belongs right before or after hint.
+  iter insert(const_iter hint, const_reference val) {
+    return (tree_.insert(hint, val));
+  }
+
+  iter insert(const_iter hint, value_type&& val) {
+    return (tree_.insert(hint, std::move(val)));
+  }
+
+  template <typename... Args>
+  iter emplace_hint(const_iter hint, Args&&... args) {
+    return (tree_.emplace_hint(hint, std::forward<Args>(args)...));
+  }
+
   template <typename... Args>
   ns::vector<std::pair<iter, bool>> insert_many(Args&&... args) {
     ns::vector<std::pair<iter, bool>> vector;
@@ -104,24 +166,113 @@ class set {
     }
   }
 
+  iter erase(const_iter first, const_iter last) {
+    tree_.erase(first, last);
+    return (iter(last.base()));
+  }
+
+  size_type erase(const key_type& key) {
+    std::pair<iter, bool> found = tree_.find(key);
+    if (!found.second) return 0;
+    tree_.erase(found.first);
+    return (1);
+  }
+
+  // Returns how many elements were erased.
+  template <typename Pred>
+  size_type erase_if(Pred pred) {
+    return (tree_.erase_if(pred));
+  }
+
   void clear() { tree_.clear(); };
 
+  // Unlinks the element and hands its node over, without freeing it. An
+  // absent key or end() gives an empty handle.
+  node_handle extract(const_iter pos) {
+    return (tree_.template extract<node_handle>(pos));
+  }
+
+  node_handle extract(const key_type& key) { return (extract(find(key))); }
+
+  // Relinks the node of handle; when the key is already present the handle
+  // comes back in the result.
+  insert_return_type insert(node_handle&& handle) {
+    std::pair<iter, bool> result = tree_.insert_node(handle, true);
+    return (insert_return_type{result.first, result.second, std::move(handle)});
+  }
+
   bool IsBalanced() { return (tree_.is_balanced()); };
 
   void swap(set& other) { tree_.swap(other.tree_); };
 
-  iter find(const Key& key) {
-    return (contains(key) ? tree_.find(key).first : nullptr);
+  iter find(const Key& key) const {
+    return (tree_.find(key).first);
+  }
+
+  bool contains(const Key& key) const { return (tree_.find(key).second); };
+
+  size_type count(const Key& key) const { return (tree_.find(key).second); }
+
+  // Batched lookups: one iterator, or one bool, per key is written to out.
+  template <typename Keys, typename OutIt>
+  OutIt find_batch(const Keys& keys, OutIt out) const {
+    return (tree_.find_batch(std::begin(keys), std::end(keys), out));
+  }
+
+  template <typename Keys, typename OutIt>
+  OutIt contains_batch(const Keys& keys, OutIt out) const {
+    return (tree_.contains_batch(std::begin(keys), std::end(keys), out));
   }
 
-  bool contains(const Key& key) { return (tree_.find(key).second); };
+  // Heterogeneous lookups, for transparent comparators only.
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  iter find(const K& key) const {
+    return (tree_.find(key).first);
+  }
+
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  bool contains(const K& key) const {
+    return (tree_.find(key).second);
+  }
+
+  template <typename K, typename C = Compare,
+            typename = std::enable_if_t<ns::is_transparent<C>::value>>
+  size_type count(const K& key) const {
+    return (tree_.find(key).second);
+  }
+
+  // Order statistics; need TreePolicy = ns::CountedTree.
+  iter nth(size_type i) const { return (tree_.nth(i)); }
+
+  size_type rank(const key_type& key) const { return (tree_.rank(key)); }
+
+  difference_type distance(const_iter first, const_iter last) const {
+    return (tree_.distance(first, last));
+  }
+
+  // Moves the nodes of other over; other is left empty. Keys present in
+  // both keep this set's element.
+  void merge(set& other) { tree_.unite(other.tree_); }
+
+  // Keeps only the keys also in other; other is left empty.
+  void intersect(set& other) { tree_.intersect(other.tree_); }
+
+  // Drops the keys found in other; other is left empty.
+  void subtract(set& other) { tree_.subtract(other.tree_); }
+
+  // Same, on several threads for large sets; see ns::parallel_t.
+  void merge(set& other, ns::parallel_t) {
+    tree_.unite(other.tree_, ns::parallel);
+  }
+
+  void intersect(set& other, ns::parallel_t) {
+    tree_.intersect(other.tree_, ns::parallel);
+  }
 
-  void merge(set& other) {
-    iter first = other.begin();
-    const iter last = other.end();
-    for (; first != last; ++first) insert(*first);
-    insert(*last);
-    other.clear();
+  void subtract(set& other, ns::parallel_t) {
+    tree_.subtract(other.tree_, ns::parallel);
   }
 
   void Print() { tree_.print(); };
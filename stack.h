@@ -1,6 +1,9 @@
 #ifndef STACK_H_
 #define STACK_H_
 
+#include <memory>
+#include <type_traits>
+
 #include "vector.h"
 
 namespace ns {
@@ -26,7 +29,23 @@ class stack {
 
   stack(const stack& s) : cont_(s.cont_){};
 
-  stack(stack&& s) { std::swap(cont_, s.cont_); };
+  stack(stack&& s) : cont_(std::move(s.cont_)){};
+
+  // Allocator-extended constructors.
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  explicit stack(const Alloc& alloc) : cont_(alloc) {}
+
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  stack(const stack& s, const Alloc& alloc) : cont_(s.cont_, alloc) {}
+
+  template <typename Alloc,
+            typename = std::enable_if_t<
+                std::uses_allocator<container_type, Alloc>::value>>
+  stack(stack&& s, const Alloc& alloc) : cont_(std::move(s.cont_), alloc) {}
 
   ~stack() {
     while (!empty()) {
@@ -37,15 +56,14 @@ class stack {
 
   stack& operator=(const stack& s) {
     if (this != &s) {
-      cont_.clear();
-      cont_.Assign(s.begin(), s.end());
+      cont_ = s.cont_;
     }
     return (*this);
   }
 
   stack& operator=(stack&& s) {
     if (this != &s) {
-      *this = std::move(s);
+      cont_ = std::move(s.cont_);
     }
     return (*this);
   }
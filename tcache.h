@@ -0,0 +1,239 @@
+#ifndef TCACHE_H_
+#define TCACHE_H_
+
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace ns {
+
+// Shared pool behind ThreadCacheAllocator. Blocks are grouped in size
+// classes of kAlign bytes up to kMaxSize and move between the depot and the
+// per-thread caches in batches, so the depot lock is taken once per kBatch
+// allocations at most. Spans are carved from ::operator new and kept for the
+// lifetime of the process.
+class CentralDepot {
+ public:
+  static constexpr std::size_t kAlign = 16;
+  static constexpr std::size_t kMaxSize = 512;
+  static constexpr std::size_t kClasses = kMaxSize / kAlign;
+  static constexpr std::size_t kBatch = 32;
+  static constexpr std::size_t kSpanSize = 64 * 1024;
+
+  struct Block {
+    Block* next;
+  };
+
+  struct Batch {
+    Block* head;
+    std::size_t count;
+  };
+
+  static CentralDepot& instance() {
+    // Never destroyed: thread caches flush into it at thread exit, which
+    // may happen after static destructors have run.
+    static CentralDepot* depot = new CentralDepot;
+    return *depot;
+  }
+
+  static std::size_t size_class(std::size_t bytes) {
+    return (bytes ? (bytes + kAlign - 1) / kAlign - 1 : 0);
+  }
+
+  Batch fetch(std::size_t cls) {
+    Shelf& shelf = shelves_[cls];
+    std::lock_guard<std::mutex> lock(shelf.mutex);
+    if (shelf.batches.empty()) Carve(shelf, (cls + 1) * kAlign);
+    Batch batch = shelf.batches.back();
+    shelf.batches.pop_back();
+    return batch;
+  }
+
+  void release(std::size_t cls, Batch batch) {
+    Shelf& shelf = shelves_[cls];
+    std::lock_guard<std::mutex> lock(shelf.mutex);
+    shelf.batches.push_back(batch);
+  }
+
+ private:
+  struct Shelf {
+    std::mutex mutex;
+    std::vector<Batch> batches;
+    std::vector<void*> spans;
+  };
+
+  Shelf shelves_[kClasses];
+
+  CentralDepot() = default;
+
+  void Carve(Shelf& shelf, std::size_t block_size) {
+    std::size_t blocks = kSpanSize / block_size;
+    if (blocks < kBatch) blocks = kBatch;
+    char* span = static_cast<char*>(::operator new(blocks * block_size));
+    shelf.spans.push_back(span);
+    for (std::size_t first = 0; first < blocks; first += kBatch) {
+      std::size_t count = blocks - first < kBatch ? blocks - first : kBatch;
+      Block* head = nullptr;
+      for (std::size_t i = first + count; i-- > first;) {
+        Block* block = reinterpret_cast<Block*>(span + i * block_size);
+        block->next = head;
+        head = block;
+      }
+      shelf.batches.push_back(Batch{head, count});
+    }
+  }
+};
+
+// Per-thread free lists in front of the CentralDepot. A block freed by a
+// thread other than the one that allocated it simply joins the freeing
+// thread's list; all blocks of a class are interchangeable.
+class ThreadCache {
+ public:
+  static ThreadCache& local() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+
+  ~ThreadCache() {
+    for (std::size_t cls = 0; cls < CentralDepot::kClasses; ++cls) {
+      FreeList& list = lists_[cls];
+      if (list.count > 0)
+        CentralDepot::instance().release(cls, Batch{list.head, list.count});
+    }
+  }
+
+  void* allocate(std::size_t cls) {
+    FreeList& list = lists_[cls];
+    if (list.head == nullptr) {
+      Batch batch = CentralDepot::instance().fetch(cls);
+      list.head = batch.head;
+      list.count = batch.count;
+    }
+    Block* block = list.head;
+    list.head = block->next;
+    --list.count;
+    return block;
+  }
+
+  void deallocate(void* ptr, std::size_t cls) {
+    FreeList& list = lists_[cls];
+    Block* block = static_cast<Block*>(ptr);
+    block->next = list.head;
+    list.head = block;
+    if (++list.count >= 2 * CentralDepot::kBatch) Flush(cls);
+  }
+
+ private:
+  using Block = CentralDepot::Block;
+  using Batch = CentralDepot::Batch;
+
+  struct FreeList {
+    Block* head = nullptr;
+    std::size_t count = 0;
+  };
+
+  FreeList lists_[CentralDepot::kClasses];
+
+  ThreadCache() = default;
+
+  // Hands one batch back to the depot and keeps the rest local.
+  void Flush(std::size_t cls) {
+    FreeList& list = lists_[cls];
+    Block* head = list.head;
+    Block* tail = head;
+    for (std::size_t i = 1; i < CentralDepot::kBatch; ++i) tail = tail->next;
+    list.head = tail->next;
+    list.count -= CentralDepot::kBatch;
+    tail->next = nullptr;
+    CentralDepot::instance().release(cls, Batch{head, CentralDepot::kBatch});
+  }
+};
+
+// Stateless allocator for containers used from many threads at once.
+// Requests up to CentralDepot::kMaxSize bytes are served from the calling
+// thread's ThreadCache; larger ones go to ::operator new.
+template <typename T>
+class ThreadCacheAllocator {
+ public:
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using is_always_equal = std::true_type;
+
+  ThreadCacheAllocator() throw(){};
+  ThreadCacheAllocator(const ThreadCacheAllocator&) throw(){};
+  template <typename U>
+  ThreadCacheAllocator(const ThreadCacheAllocator<U>&) throw(){};
+  ~ThreadCacheAllocator(){};
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+
+  pointer allocate(size_type n) {
+    if (n > max_size()) throw std::bad_array_new_length();
+    size_type bytes = n * sizeof(value_type);
+    if (!Cached(bytes))
+      return static_cast<pointer>(::operator new(bytes));
+    return static_cast<pointer>(
+        ThreadCache::local().allocate(CentralDepot::size_class(bytes)));
+  }
+
+  void deallocate(void* ptr, size_type n) {
+    size_type bytes = n * sizeof(value_type);
+    if (!Cached(bytes))
+      ::operator delete(ptr);
+    else
+      ThreadCache::local().deallocate(ptr, CentralDepot::size_class(bytes));
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  size_type max_size() const noexcept {
+    return std::numeric_limits<size_type>::max() / sizeof(value_type);
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = ThreadCacheAllocator<U>;
+  };
+
+ private:
+  static bool Cached(size_type bytes) {
+    return bytes <= CentralDepot::kMaxSize &&
+           alignof(value_type) <= CentralDepot::kAlign;
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ThreadCacheAllocator<T>&,
+                const ThreadCacheAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ThreadCacheAllocator<T>&,
+                const ThreadCacheAllocator<U>&) {
+  return false;
+}
+
+}  // namespace ns
+
+#endif  // TCACHE_H_
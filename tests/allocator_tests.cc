@@ -0,0 +1,361 @@
+#include "unit-tests.h"
+
+TEST(allocator, linear_arena_bumps) {
+  ns::LinearArena arena(256);
+  char* first = static_cast<char*>(arena.allocate(10, 1));
+  char* second = static_cast<char*>(arena.allocate(6, 1));
+  EXPECT_EQ(first + 10, second);
+
+  void* aligned = arena.allocate(8, 8);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 8, 0);
+
+  char* big = static_cast<char*>(arena.allocate(1000, 16));
+  for (int i = 0; i < 1000; ++i) big[i] = 'x';
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(big) % 16, 0);
+}
+
+TEST(allocator, linear_arena_reset) {
+  ns::LinearArena arena(128);
+  void* first = arena.allocate(64, 8);
+  arena.allocate(100, 8);
+  arena.allocate(100, 8);
+  arena.reset();
+  EXPECT_EQ(arena.allocate(64, 8), first);
+  arena.allocate(100, 8);
+  arena.allocate(100, 8);
+  arena.release();
+  EXPECT_NE(arena.allocate(16, 8), nullptr);
+}
+
+TEST(allocator, linear_allocator_rebind_shares_arena) {
+  ns::LinearAllocator<int> alloc;
+  ns::LinearAllocator<ns::RBTnode<int>> node_alloc(alloc);
+  EXPECT_EQ(alloc.arena(), node_alloc.arena());
+  EXPECT_TRUE(alloc == node_alloc);
+  EXPECT_FALSE(alloc == ns::LinearAllocator<int>());
+}
+
+TEST(allocator, linear_allocator_containers) {
+  using alloc_type = ns::LinearAllocator<std::pair<int, std::string>>;
+  ns::map<int, std::string, std::less<int>, alloc_type> ns_map;
+  std::map<int, std::string> std_map;
+  for (int i = 0; i < 1000; ++i) {
+    ns_map.insert(i, std::to_string(i));
+    std_map.insert({i, std::to_string(i)});
+  }
+  EXPECT_EQ(ns_map.size(), std_map.size());
+  EXPECT_EQ(ns_map.at(500), std_map.at(500));
+
+  ns::list<std::string, ns::LinearAllocator<std::string>> ns_list;
+  for (int i = 0; i < 100; ++i) ns_list.push_back(std::to_string(i));
+  ns_list.pop_front();
+  EXPECT_EQ(ns_list.front(), "1");
+  EXPECT_EQ(ns_list.size(), 99);
+
+  ns::vector<int, ns::LinearAllocator<int>> ns_vector;
+  for (int i = 0; i < 1000; ++i) ns_vector.push_back(i);
+  EXPECT_EQ(ns_vector[999], 999);
+}
+
+TEST(allocator, node_pool_recycles_blocks) {
+  ns::NodePool pool(24, 4);
+  char* first = static_cast<char*>(pool.allocate());
+  char* second = static_cast<char*>(pool.allocate());
+  EXPECT_EQ(first + pool.block_size(), second);
+  EXPECT_EQ(pool.slab_count(), 1);
+
+  pool.deallocate(first);
+  EXPECT_EQ(pool.allocate(), first);
+
+  pool.reserve(10);
+  EXPECT_GE(pool.available(), 10);
+  size_t slabs = pool.slab_count();
+  for (int i = 0; i < 10; ++i) pool.allocate();
+  EXPECT_EQ(pool.slab_count(), slabs);
+}
+
+TEST(allocator, pool_allocator_rebind) {
+  ns::PoolAllocator<long> alloc(64, true);
+  ns::PoolAllocator<double> same_size(alloc);
+  ns::PoolAllocator<ns::RBTnode<long>> node_alloc(alloc);
+  ns::PoolAllocator<long> back(node_alloc);
+  EXPECT_TRUE(alloc == same_size);
+  EXPECT_TRUE(alloc == node_alloc);
+  EXPECT_TRUE(back == alloc);
+  EXPECT_EQ(alloc.pool(), same_size.pool());
+  EXPECT_EQ(alloc.pool(), back.pool());
+  EXPECT_NE(alloc.pool(), node_alloc.pool());
+  EXPECT_EQ(node_alloc.pool()->slab_blocks(), 64);
+  EXPECT_TRUE(node_alloc.pool()->prefault());
+  EXPECT_FALSE(alloc == ns::PoolAllocator<long>(64, true));
+}
+
+TEST(allocator, pool_allocator_shared_by_containers) {
+  using set_type = ns::set<int, std::less<int>, ns::PoolAllocator<int>>;
+  ns::PoolAllocator<int> alloc;
+  set_type A(alloc);
+  set_type B(alloc);
+  EXPECT_TRUE(A.get_allocator() == alloc);
+  for (int i = 0; i < 10; ++i) A.insert(i);
+  const int* address = &*A.find(4);
+  auto result = B.insert(A.extract(4));
+  EXPECT_EQ(&*result.position, address);
+}
+
+TEST(allocator, pool_allocator_set_churn) {
+  ns::set<int, std::less<int>, ns::PoolAllocator<int>> ns_set;
+  for (int i = 0; i < 1000; ++i) ns_set.insert(i);
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 500; ++i) ns_set.erase(ns_set.find(i));
+    for (int i = 0; i < 500; ++i) ns_set.insert(i);
+  }
+  EXPECT_EQ(ns_set.size(), 1000);
+  EXPECT_TRUE(ns_set.contains(0));
+  EXPECT_TRUE(ns_set.contains(999));
+
+  ns::list<std::string, ns::PoolAllocator<std::string>> ns_list;
+  for (int i = 0; i < 100; ++i) ns_list.push_back(std::to_string(i));
+  for (int i = 0; i < 50; ++i) ns_list.pop_front();
+  EXPECT_EQ(ns_list.front(), "50");
+}
+
+TEST(allocator, pool_allocator_list_move) {
+  using list_type = ns::list<int, ns::PoolAllocator<int>>;
+  list_type* source = new list_type;
+  for (int i = 0; i < 10; ++i) source->push_back(i);
+  list_type moved(std::move(*source));
+  delete source;
+  int expected = 0;
+  for (int value : moved) EXPECT_EQ(value, expected++);
+  EXPECT_EQ(expected, 10);
+  moved.push_back(10);
+  EXPECT_EQ(moved.back(), 10);
+}
+
+TEST(allocator, pool_allocator_list_sort) {
+  ns::list<int, ns::PoolAllocator<int>> A;
+  for (int i = 0; i < 100; ++i) A.push_back(i * 37 % 100);
+  A.sort();
+  int expected = 0;
+  for (int value : A) EXPECT_EQ(value, expected++);
+  EXPECT_EQ(A.size(), 100);
+  A.pop_front();
+  A.push_front(-1);
+  EXPECT_EQ(A.front(), -1);
+}
+
+TEST(allocator, thread_cache_reuses_blocks) {
+  ns::ThreadCacheAllocator<long> alloc;
+  long* first = alloc.allocate(1);
+  alloc.deallocate(first, 1);
+  EXPECT_EQ(alloc.allocate(1), first);
+  alloc.deallocate(first, 1);
+
+  long* big = alloc.allocate(1000);
+  big[999] = 1;
+  alloc.deallocate(big, 1000);
+}
+
+TEST(allocator, thread_cache_cross_thread_free) {
+  using alloc_type = ns::ThreadCacheAllocator<std::string>;
+  const int threads = 4;
+  std::vector<ns::list<std::string, alloc_type>> lists(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&lists, t] {
+      using map_alloc = ns::ThreadCacheAllocator<std::pair<int, int>>;
+      ns::map<int, int, std::less<int>, map_alloc> local;
+      for (int i = 0; i < 2000; ++i) {
+        local.insert(i, t);
+        lists[t].push_back(std::to_string(i));
+      }
+      EXPECT_EQ(local.size(), 2000);
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  workers.clear();
+
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&lists, t] {
+      ns::list<std::string, alloc_type>& other = lists[(t + 1) % threads];
+      EXPECT_EQ(other.size(), 2000);
+      other.clear();
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  for (auto& list : lists) EXPECT_TRUE(list.empty());
+}
+
+// Stateful allocator that never propagates, used to drive the paths where
+// two containers hold unequal allocators.
+template <typename T>
+struct StickyAllocator : ns::allocator<T> {
+  using value_type = T;
+  using is_always_equal = std::false_type;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::false_type;
+
+  template <typename U>
+  struct rebind {
+    using other = StickyAllocator<U>;
+  };
+
+  explicit StickyAllocator(int tag = 0) : id(tag) {}
+  template <typename U>
+  StickyAllocator(const StickyAllocator<U>& other) : id(other.id) {}
+
+  friend bool operator==(const StickyAllocator& lhs,
+                         const StickyAllocator& rhs) {
+    return lhs.id == rhs.id;
+  }
+  friend bool operator!=(const StickyAllocator& lhs,
+                         const StickyAllocator& rhs) {
+    return lhs.id != rhs.id;
+  }
+
+  int id;
+};
+
+TEST(allocator, linear_allocator_propagation) {
+  using alloc_type = ns::LinearAllocator<int>;
+  alloc_type first_arena, second_arena;
+  ns::vector<int, alloc_type> first({1, 2, 3}, first_arena);
+  ns::vector<int, alloc_type> copy(first);
+  EXPECT_EQ(copy.get_allocator(), first_arena);
+
+  ns::vector<int, alloc_type> second({4, 5}, second_arena);
+  second = copy;
+  EXPECT_EQ(second.get_allocator(), second_arena);
+  EXPECT_EQ(second.size(), 3);
+
+  second = std::move(first);
+  EXPECT_EQ(second.get_allocator(), first_arena);
+  EXPECT_EQ(second[2], 3);
+
+  ns::vector<int, alloc_type> third({7}, second_arena);
+  third.swap(second);
+  EXPECT_EQ(third.get_allocator(), first_arena);
+  EXPECT_EQ(second.get_allocator(), second_arena);
+  EXPECT_EQ(second[0], 7);
+}
+
+TEST(allocator, allocator_extended_constructors) {
+  ns::LinearAllocator<int> arena;
+  ns::list<int, ns::LinearAllocator<int>> list({1, 2, 3});
+  ns::list<int, ns::LinearAllocator<int>> copy(list, arena);
+  EXPECT_EQ(copy.get_allocator(), arena);
+  EXPECT_NE(list.get_allocator(), arena);
+  EXPECT_EQ(copy.back(), 3);
+
+  ns::set<int, std::less<int>, ns::LinearAllocator<int>> set({5, 1, 3}, arena);
+  EXPECT_EQ(set.get_allocator(), arena);
+  ns::set<int, std::less<int>, ns::LinearAllocator<int>> moved(std::move(set));
+  EXPECT_EQ(moved.get_allocator(), arena);
+  EXPECT_EQ(moved.size(), 3);
+  EXPECT_TRUE(set.empty());
+
+  ns::stack<int, ns::vector<int, ns::LinearAllocator<int>>> stack(arena);
+  stack.push(1);
+  ns::stack<int, ns::vector<int, ns::LinearAllocator<int>>> other(
+      std::move(stack));
+  EXPECT_EQ(other.top(), 1);
+}
+
+TEST(allocator, unequal_allocators_move_elements) {
+  using alloc_type = StickyAllocator<std::string>;
+  ns::vector<std::string, alloc_type> first({"a", "b"}, alloc_type(1));
+  ns::vector<std::string, alloc_type> second(alloc_type(2));
+  second = std::move(first);
+  EXPECT_EQ(second.get_allocator().id, 2);
+  EXPECT_EQ(second.size(), 2);
+  EXPECT_EQ(second[1], "b");
+
+  ns::list<std::string, alloc_type> list({"x", "y"}, alloc_type(1));
+  ns::list<std::string, alloc_type> other(std::move(list), alloc_type(2));
+  EXPECT_EQ(other.get_allocator().id, 2);
+  EXPECT_EQ(other.size(), 2);
+  EXPECT_TRUE(list.empty());
+
+  using map_alloc = StickyAllocator<std::pair<int, std::string>>;
+  ns::map<int, std::string, std::less<int>, map_alloc> map(map_alloc(1));
+  map.insert(1, "one");
+  ns::map<int, std::string, std::less<int>, map_alloc> target(map_alloc(2));
+  target = std::move(map);
+  EXPECT_EQ(target.get_allocator().id, 2);
+  EXPECT_EQ(target.at(1), "one");
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(allocator, pmr_monotonic_resource) {
+  ns::pmr::monotonic_buffer_resource arena(256);
+  ns::pmr::vector<int> vector(&arena);
+  for (int i = 0; i < 100; ++i) vector.push_back(i);
+  EXPECT_EQ(vector.get_allocator().resource(), &arena);
+  EXPECT_EQ(vector[99], 99);
+
+  ns::pmr::map<int, std::string> map(&arena);
+  map.insert(2, "two");
+  map.insert(1, "one");
+  EXPECT_EQ(map.at(1), "one");
+  EXPECT_EQ(map.get_allocator().resource(), &arena);
+}
+
+TEST(allocator, pmr_pool_resource_recycles) {
+  ns::pmr::unsynchronized_pool_resource pool;
+  void* first = pool.allocate(24, 8);
+  pool.deallocate(first, 24, 8);
+  EXPECT_EQ(pool.allocate(20, 8), first);
+  void* big = pool.allocate(4096, 16);
+  pool.deallocate(big, 4096, 16);
+
+  ns::pmr::set<int> set({5, 3, 9, 1}, &pool);
+  ns::pmr::list<int> list({1, 2, 3}, &pool);
+  EXPECT_EQ(set.size(), 4);
+  EXPECT_EQ(list.back(), 3);
+}
+
+TEST(allocator, pmr_containers_share_type) {
+  ns::pmr::monotonic_buffer_resource arena;
+  ns::pmr::synchronized_pool_resource pool;
+  ns::pmr::vector<int> first({1, 2}, &arena);
+  ns::pmr::vector<int> second({3, 4, 5}, &pool);
+  EXPECT_NE(first.get_allocator(), second.get_allocator());
+
+  first = std::move(second);
+  EXPECT_EQ(first.get_allocator().resource(), &arena);
+  EXPECT_EQ(first.size(), 3);
+
+  ns::pmr::vector<int> copy(first);
+  EXPECT_EQ(copy.get_allocator().resource(),
+            ns::pmr::get_default_resource());
+}
+
+TEST(allocator, pmr_nested_containers_inherit_resource) {
+  ns::pmr::unsynchronized_pool_resource pool;
+  ns::pmr::vector<ns::pmr::list<int>> lists(&pool);
+  lists.emplace_back();
+  lists.emplace_back(ns::pmr::list<int>({1, 2}));
+  lists.reserve(10);
+  EXPECT_EQ(lists[0].get_allocator().resource(), &pool);
+  EXPECT_EQ(lists[1].get_allocator().resource(), &pool);
+  EXPECT_EQ(lists[1].size(), 2);
+}
+
+TEST(allocator, pmr_tree_elements_inherit_resource) {
+  ns::pmr::unsynchronized_pool_resource pool;
+  ns::pmr::unsynchronized_pool_resource other;
+  ns::pmr::map<int, ns::pmr::vector<int>> vectors(&pool);
+  vectors[1].push_back(10);
+  vectors.emplace(2, ns::pmr::vector<int>({20, 21}));
+  vectors.insert(std::make_pair(3, ns::pmr::vector<int>(2, 30)));
+  for (int key = 1; key <= 3; ++key)
+    EXPECT_EQ(vectors.at(key).get_allocator().resource(), &pool);
+  EXPECT_EQ(vectors.at(2).size(), 2);
+  ns::pmr::map<int, ns::pmr::vector<int>> copy(vectors, &other);
+  EXPECT_EQ(copy.at(1).get_allocator().resource(), &other);
+  EXPECT_EQ(copy.at(3)[1], 30);
+  ns::pmr::map<int, ns::pmr::set<int>> sets(&pool);
+  sets[1].insert(1);
+  EXPECT_EQ(sets.at(1).get_allocator().resource(), &pool);
+}
@@ -92,7 +92,8 @@ TEST(multiset, func_end_2) {
   std::multiset<int> B = {9, 10, 123, -4, 5, 9, 9, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
-  A1++, B1++;
+  A1--, B1--;
+  A1--, B1--;
   EXPECT_EQ((*A1), (*B1));
 }
 
@@ -110,8 +111,10 @@ TEST(multiset, func_end_4) {
   std::multiset<int> B = {9, 10, 123, -4, 5, 9, 9, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
+  --A1, --B1;
   ++A1, ++B1;
-  EXPECT_EQ((*A1), (*B1));
+  EXPECT_TRUE(A1 == A.end());
+  EXPECT_TRUE(B1 == B.end());
 }
 TEST(multiset, func_cend_1) {
   const ns::multiset<int> A = {9, 10, 123, -4, 5, 9, 9, 123, -4};
@@ -254,7 +257,7 @@ TEST(multiset, func_erase_1) {
 TEST(multiset, func_erase_2) {
   ns::multiset<int> A = {9, 10, 123, -4, 5, 9, 9, 123, -4};
   std::multiset<int> B = {9, 10, 123, -4, 5, 9, 9, 123, -4};
-  A.erase(A.end());
+  A.erase(--A.end());
   B.erase(--B.end());
   EXPECT_TRUE(compare_multiset(A, B));
   EXPECT_EQ(A.size(), B.size());
@@ -347,7 +350,7 @@ TEST(multiset, func_find_1) {
 TEST(multiset, func_find_2) {
   ns::multiset<int> A{1, 2, 3, 4, 5};
   auto A1 = A.find(6);
-  EXPECT_TRUE(A1 == (nullptr));
+  EXPECT_TRUE(A1 == A.end());
 }
 
 TEST(multiset, func_count_1) {
@@ -510,3 +513,177 @@ TEST(multiset, big_erase_1) {
   }
   EXPECT_TRUE(A.empty());
 }
+
+TEST(multiset, from_sorted) {
+  std::vector<int> keys{1, 1, 2, 5, 5, 5, 8, 9, 9};
+  auto A = ns::multiset<int>::from_sorted(keys.begin(), keys.end());
+  std::multiset<int> B(keys.begin(), keys.end());
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_multiset(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+  EXPECT_EQ(A.count(5), 3);
+  ns::multiset<int> C(ns::sorted_equivalent, {3, 3, 4});
+  EXPECT_EQ(C.count(3), 2);
+}
+
+TEST(multiset, merge_keeps_duplicates) {
+  ns::multiset<int> A{1, 3, 3, 5};
+  ns::multiset<int> B{3, 4, 5, 5};
+  A.merge(B);
+  std::multiset<int> C{1, 3, 3, 3, 4, 5, 5, 5};
+  EXPECT_EQ(A.size(), C.size());
+  EXPECT_TRUE(compare_multiset(A, C));
+  EXPECT_TRUE(A.IsBalanced());
+  EXPECT_TRUE(B.empty());
+}
+
+TEST(multiset, order_statistics) {
+  using counted =
+      ns::multiset<int, std::less<int>, ns::allocator<int>, ns::CountedTree>;
+  counted A;
+  std::multiset<int> B;
+  unsigned seed = 7;
+  for (int i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 100;
+    if (i % 3 == 2 && A.contains(key)) {
+      A.erase(A.find(key));
+      B.erase(B.find(key));
+    } else {
+      A.insert(key);
+      B.insert(key);
+    }
+  }
+  ASSERT_EQ(A.size(), B.size());
+  EXPECT_TRUE(A.IsBalanced());
+  for (int key = -1; key <= 100; ++key) {
+    EXPECT_EQ(A.count(key), B.count(key));
+    EXPECT_EQ(A.rank(key), std::distance(B.begin(), B.lower_bound(key)));
+    EXPECT_EQ(A.distance(A.lower_bound(key), A.upper_bound(key)),
+              static_cast<std::ptrdiff_t>(B.count(key)));
+  }
+  auto it = B.begin();
+  for (std::size_t i = 0; i < B.size(); ++i, ++it) EXPECT_EQ(*A.nth(i), *it);
+  EXPECT_TRUE(A.nth(B.size()) == A.end());
+  EXPECT_EQ(A.distance(A.begin(), A.end()),
+            static_cast<std::ptrdiff_t>(B.size()));
+
+  counted C(A);
+  counted D(ns::sorted_equivalent, {5, 5, 5, 200});
+  C.merge(D);
+  EXPECT_EQ(C.count(5), B.count(5) + 3);
+  EXPECT_EQ(C.rank(200), B.size() + 3);
+  EXPECT_TRUE(C.IsBalanced());
+}
+
+TEST(multiset, insert_with_hint) {
+  ns::multiset<int> A;
+  std::multiset<int> B;
+  unsigned seed = 11;
+  for (int i = 0; i < 1000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 50;
+    auto hint = i % 2 ? A.lower_bound(key) : A.lower_bound((seed >> 4) % 50);
+    auto it = A.emplace_hint(hint, key);
+    EXPECT_EQ(*it, key);
+    B.insert(key);
+  }
+  A.insert(A.cend(), 100);
+  A.insert(A.cbegin(), -1);
+  B.insert({100, -1});
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_multiset(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(multiset, extract_and_insert_node) {
+  ns::multiset<int> A{1, 2, 2, 2, 3};
+  ns::multiset<int> B{2, 4};
+  for (int i = 0; i < 3; ++i) B.insert(A.extract(2));
+  EXPECT_TRUE(B.insert(A.extract(2)) == B.end());
+  std::multiset<int> C{2, 2, 2, 2, 4};
+  EXPECT_EQ(A.size(), 2);
+  EXPECT_EQ(B.size(), C.size());
+  EXPECT_TRUE(compare_multiset(B, C));
+  EXPECT_TRUE(B.IsBalanced());
+}
+
+TEST(multiset, transparent_lookup) {
+  ns::multiset<std::string, std::less<>> A{"a", "b", "b", "c"};
+  std::string_view key("b");
+  EXPECT_EQ(A.count(key), 2);
+  EXPECT_TRUE(A.contains(std::string_view("c")));
+  EXPECT_FALSE(A.contains("d"));
+  EXPECT_EQ(*A.find(key), "b");
+}
+
+TEST(multiset, emplace_in_place) {
+  ns::multiset<std::string> A;
+  A.emplace(3, 'a');
+  A.emplace("aaa");
+  std::string value("b");
+  A.insert(std::move(value));
+  A.emplace_hint(A.cbegin(), 1, 'a');
+  std::multiset<std::string> B{"aaa", "aaa", "b", "a"};
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_multiset(A, B));
+}
+
+TEST(multiset, erase_key_and_range) {
+  std::vector<int> keys;
+  for (int i = 0; i < 1000; ++i) keys.push_back(i / 100);
+  ns::multiset<int> A(ns::sorted_equivalent, keys.begin(), keys.end());
+  std::multiset<int> B(keys.begin(), keys.end());
+  EXPECT_EQ(A.erase(3), 100);
+  EXPECT_EQ(A.erase(3), 0);
+  B.erase(3);
+  auto first = std::next(A.cbegin(), 150);
+  A.erase(first, std::next(first, 420));
+  B.erase(std::next(B.begin(), 150), std::next(B.begin(), 570));
+  EXPECT_EQ(A.erase_if([](int key) { return key == 7; }), B.count(7));
+  B.erase(7);
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_multiset(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(multiset, for_each_keeps_duplicates) {
+  ns::multiset<int> A{5, 1, 3, 3, 5, 5, 0};
+  std::vector<int> seen;
+  A.for_each([&seen](int key) { seen.push_back(key); });
+  EXPECT_EQ(seen, std::vector<int>({0, 1, 3, 3, 5, 5, 5}));
+}
+
+TEST(multiset, index_linked_nodes) {
+  ns::multiset<int, std::less<int>, ns::IndexPoolAllocator<int>,
+               ns::CountedTree>
+      A;
+  std::multiset<int> B;
+  for (int i = 0; i < 3000; ++i) {
+    A.insert(i * 7919 % 500);
+    B.insert(i * 7919 % 500);
+  }
+  EXPECT_TRUE(std::equal(A.begin(), A.end(), B.begin(), B.end()));
+  EXPECT_EQ(A.count(250), B.count(250));
+  EXPECT_EQ(A.rank(250), std::distance(B.begin(), B.lower_bound(250)));
+}
+
+TEST(multiset, contains_batch) {
+  ns::multiset<int> A{4, 4, 8, 15, 16, 23, 42, 42};
+  std::vector<bool> present;
+  A.contains_batch(std::vector<int>{42, 5, 4, 0, 23, 43},
+                   std::back_inserter(present));
+  EXPECT_EQ(present, std::vector<bool>({true, false, true, false, true,
+                                        false}));
+}
+
+TEST(multiset, user_comparator_orders_tree) {
+  ns::multiset<int, std::greater<>> A{3, 1, 4, 1, 5, 9, 2, 6};
+  std::vector<int> seen(A.begin(), A.end());
+  EXPECT_EQ(seen, std::vector<int>({9, 6, 5, 4, 3, 2, 1, 1}));
+  EXPECT_EQ(A.count(1), 2);
+  EXPECT_EQ(*A.lower_bound(4), 4);
+  EXPECT_EQ(*A.upper_bound(4), 3);
+  EXPECT_TRUE(A.contains(9L));
+  EXPECT_TRUE(A.IsBalanced());
+}
@@ -139,7 +139,7 @@ TEST(set, func_end_1) {
   std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
-  B1--;  // разная реализация end()
+  A1--, B1--;
   EXPECT_EQ((*A1), (*B1));
 }
 
@@ -148,7 +148,8 @@ TEST(set, func_end_2) {
   std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
-  A1++, B1++;
+  A1--, B1--;
+  A1--, B1--;
   EXPECT_EQ((*A1), (*B1));
 }
 
@@ -157,7 +158,7 @@ TEST(set, func_end_3) {
   std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
-  --B1;  // разная реализация end()
+  --A1, --B1;
   EXPECT_EQ((*A1), (*B1));
 }
 
@@ -166,8 +167,10 @@ TEST(set, func_end_4) {
   std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.end();
   auto B1 = B.end();
+  --A1, --B1;
   ++A1, ++B1;
-  EXPECT_EQ((*A1), (*B1));
+  EXPECT_TRUE(A1 == A.end());
+  EXPECT_TRUE(B1 == B.end());
 }
 
 TEST(set, func_cend_1) {
@@ -175,7 +178,7 @@ TEST(set, func_cend_1) {
   const std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.cend();
   auto B1 = B.cend();
-  --B1;  // разная реализация end()
+  --A1, --B1;
   EXPECT_EQ((*A1), (*B1));
 }
 
@@ -184,7 +187,7 @@ TEST(set, func_cend_2) {
   const std::set<int> B = {9, 10, 123, -4};
   auto A1 = A.cend();
   auto B1 = B.cend();
-  B1--;  // разная реализация end()
+  A1--, B1--;
   EXPECT_EQ((*A1), (*B1));
 }
 TEST(set, func_cbegin_1) {
@@ -307,7 +310,7 @@ TEST(set, func_clear_2) {
 TEST(set, func_erase_1) {
   ns::set<int> A = {9, 10, 123, -4};
   std::set<int> B = {9, 10, 123, -4};
-  A.erase(A.end());
+  A.erase(--A.end());
   B.erase(--B.end());
   EXPECT_EQ(A.size(), B.size());
 }
@@ -398,7 +401,7 @@ TEST(set, func_find_1) {
 
 TEST(set, func_find_2) {
   ns::set<int> A{1, 2, 3, 4, 5};
-  auto A1 = A.find(5);
+  auto A1 = A.find(6);
   auto A2 = A.end();
   EXPECT_TRUE(A1 == A2);
 }
@@ -455,3 +458,527 @@ TEST(set, big_erase_1) {
   }
   EXPECT_TRUE(A.empty());
 }
+
+TEST(set, end_is_past_the_end) {
+  ns::set<int> A;
+  EXPECT_TRUE(A.begin() == A.end());
+  A.insert(7);
+  auto A1 = A.begin();
+  ++A1;
+  EXPECT_TRUE(A1 == A.end());
+  --A1;
+  EXPECT_EQ(*A1, 7);
+  A.insert(9);
+  A.insert(3);
+  EXPECT_EQ(*(--A.end()), 9);
+  EXPECT_EQ(*A.begin(), 3);
+  A.clear();
+  EXPECT_TRUE(A.begin() == A.end());
+}
+
+TEST(set, swap_keeps_end) {
+  ns::set<int> A{1, 2, 3};
+  ns::set<int> B;
+  A.swap(B);
+  EXPECT_TRUE(A.begin() == A.end());
+  int sum = 0;
+  for (auto it = B.begin(); it != B.end(); ++it) sum += *it;
+  EXPECT_EQ(sum, 6);
+  ns::set<int> C(std::move(B));
+  EXPECT_TRUE(B.begin() == B.end());
+  EXPECT_EQ(*(--C.end()), 3);
+}
+
+TEST(set, random_insert_erase_matches_std) {
+  ns::set<int> A;
+  std::set<int> B;
+  unsigned seed = 12345;
+  for (int i = 0; i < 5000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int key = (seed >> 8) % 500;
+    if (seed & 0x10000) {
+      A.insert(key);
+      B.insert(key);
+    } else if (A.contains(key)) {
+      A.erase(A.find(key));
+      B.erase(key);
+    }
+  }
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_set(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+  auto A1 = A.end();
+  for (auto B1 = B.rbegin(); B1 != B.rend(); ++B1) EXPECT_EQ(*--A1, *B1);
+  EXPECT_TRUE(A1 == A.begin());
+}
+
+TEST(set, large_copy_matches_source) {
+  ns::set<int> A;
+  const int n = 40000;
+  for (int i = 0; i < n; ++i) A.insert(i * 7919 % n);
+  ns::set<int> B(A);
+  EXPECT_EQ(B.size(), A.size());
+  EXPECT_TRUE(B.IsBalanced());
+  int expected = 0;
+  for (auto it = B.begin(); it != B.end(); ++it) EXPECT_EQ(*it, expected++);
+  EXPECT_EQ(expected, n);
+  EXPECT_EQ(*(--B.end()), n - 1);
+
+  ns::set<int> P(ns::parallel, A);
+  EXPECT_TRUE(std::equal(P.begin(), P.end(), B.begin(), B.end()));
+  EXPECT_TRUE(P.IsBalanced());
+  EXPECT_EQ(*P.begin(), 0);
+  EXPECT_EQ(*(--P.end()), n - 1);
+
+  ns::set<int, std::less<int>, ns::LinearAllocator<int>> C;
+  for (int i = 0; i < n; ++i) C.insert(i);
+  ns::set<int, std::less<int>, ns::LinearAllocator<int>> D(C);
+  EXPECT_EQ(D.size(), C.size());
+  EXPECT_TRUE(D.IsBalanced());
+}
+
+TEST(set, from_sorted_is_balanced) {
+  for (int n = 0; n < 300; ++n) {
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; ++i) keys[i] = i * 3;
+    ns::set<int> A = ns::set<int>::from_sorted(keys.begin(), keys.end());
+    ASSERT_EQ(A.size(), n);
+    ASSERT_TRUE(A.IsBalanced());
+    ASSERT_TRUE(compare_set(A, std::set<int>(keys.begin(), keys.end())));
+    if (n) {
+      EXPECT_EQ(*(--A.end()), (n - 1) * 3);
+    }
+  }
+}
+
+TEST(set, from_sorted_drops_repeats) {
+  ns::set<int> A(ns::sorted_unique, {1, 1, 2, 3, 3, 3, 7});
+  std::set<int> B{1, 2, 3, 7};
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(compare_set(A, B));
+  A.insert(5);
+  A.erase(A.find(2));
+  B.insert(5);
+  B.erase(2);
+  EXPECT_TRUE(compare_set(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+#ifndef NDEBUG
+TEST(set, from_sorted_rejects_unsorted_input) {
+  EXPECT_DEATH(ns::set<int>(ns::sorted_unique, {1, 5, 3}), "not sorted");
+}
+#endif
+
+TEST(set, from_sorted_input_iterator) {
+  std::istringstream in("1 4 4 9 16");
+  ns::set<int> A(ns::sorted_unique, std::istream_iterator<int>(in),
+                 std::istream_iterator<int>());
+  EXPECT_TRUE(compare_set(A, {1, 4, 9, 16}));
+  EXPECT_EQ(A.size(), 4);
+}
+
+static std::set<int> RandomKeys(int count, int range, unsigned seed) {
+  std::set<int> keys;
+  for (int i = 0; i < count; ++i) {
+    seed = seed * 1103515245 + 12345;
+    keys.insert((seed >> 8) % range);
+  }
+  return keys;
+}
+
+TEST(set, join_based_algebra) {
+  const int sizes[][2] = {{0, 5}, {5, 0}, {1, 300}, {300, 1}, {200, 250}};
+  for (auto size : sizes) {
+    std::set<int> keys_a = RandomKeys(size[0], 600, 1);
+    std::set<int> keys_b = RandomKeys(size[1], 600, 2);
+    std::set<int> expected;
+
+    ns::set<int> A(ns::sorted_unique, keys_a.begin(), keys_a.end());
+    ns::set<int> B(ns::sorted_unique, keys_b.begin(), keys_b.end());
+    A.merge(B);
+    std::set_union(keys_a.begin(), keys_a.end(), keys_b.begin(), keys_b.end(),
+                   std::inserter(expected, expected.end()));
+    EXPECT_EQ(A.size(), expected.size());
+    EXPECT_TRUE(compare_set(A, expected));
+    EXPECT_TRUE(A.IsBalanced());
+    EXPECT_TRUE(B.empty());
+    EXPECT_TRUE(B.begin() == B.end());
+
+    A = ns::set<int>(ns::sorted_unique, keys_a.begin(), keys_a.end());
+    B = ns::set<int>(ns::sorted_unique, keys_b.begin(), keys_b.end());
+    A.intersect(B);
+    expected.clear();
+    std::set_intersection(keys_a.begin(), keys_a.end(), keys_b.begin(),
+                          keys_b.end(),
+                          std::inserter(expected, expected.end()));
+    EXPECT_EQ(A.size(), expected.size());
+    EXPECT_TRUE(compare_set(A, expected));
+    EXPECT_TRUE(A.IsBalanced());
+    EXPECT_TRUE(B.empty());
+
+    A = ns::set<int>(ns::sorted_unique, keys_a.begin(), keys_a.end());
+    B = ns::set<int>(ns::sorted_unique, keys_b.begin(), keys_b.end());
+    A.subtract(B);
+    expected.clear();
+    std::set_difference(keys_a.begin(), keys_a.end(), keys_b.begin(),
+                        keys_b.end(), std::inserter(expected, expected.end()));
+    EXPECT_EQ(A.size(), expected.size());
+    EXPECT_TRUE(compare_set(A, expected));
+    EXPECT_TRUE(A.IsBalanced());
+    EXPECT_TRUE(B.empty());
+  }
+}
+
+TEST(set, merge_steals_nodes) {
+  ns::set<int> A{1, 3, 5};
+  ns::set<int> B{2, 3, 4};
+  const int* two = &*B.begin();
+  A.merge(B);
+  EXPECT_EQ(&*(++A.begin()), two);
+  EXPECT_EQ(A.size(), 5);
+  A.insert(6);
+  A.erase(A.find(1));
+  EXPECT_TRUE(compare_set(A, {2, 3, 4, 5, 6}));
+}
+
+TEST(set, parallel_union) {
+  std::set<int> keys_a = RandomKeys(50000, 1 << 20, 3);
+  std::set<int> keys_b = RandomKeys(50000, 1 << 20, 4);
+  ns::set<int> A(ns::sorted_unique, keys_a.begin(), keys_a.end());
+  ns::set<int> B(ns::sorted_unique, keys_b.begin(), keys_b.end());
+  ns::set<int> C(A);
+  ns::set<int> D(B);
+  A.merge(B, ns::parallel);
+  C.intersect(D, ns::parallel);
+  std::set<int> common;
+  for (int key : keys_b)
+    if (keys_a.count(key)) common.insert(key);
+  EXPECT_TRUE(compare_set(C, common));
+  EXPECT_TRUE(C.IsBalanced());
+  keys_a.insert(keys_b.begin(), keys_b.end());
+  EXPECT_EQ(A.size(), keys_a.size());
+  EXPECT_TRUE(compare_set(A, keys_a));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(set, order_statistics) {
+  using counted =
+      ns::set<int, std::less<int>, ns::allocator<int>, ns::CountedTree>;
+  std::set<int> keys_a = RandomKeys(500, 2000, 3);
+  std::set<int> keys_b = RandomKeys(500, 2000, 4);
+  counted A(ns::sorted_unique, keys_a.begin(), keys_a.end());
+  counted B(ns::sorted_unique, keys_b.begin(), keys_b.end());
+  counted C(A);
+  counted D(B);
+  C.intersect(D);
+  A.merge(B);
+  std::set<int> expected(keys_a);
+  expected.insert(keys_b.begin(), keys_b.end());
+  for (int i = 0; i < 100; ++i) {
+    A.erase(A.nth(i * 3));
+    expected.erase(std::next(expected.begin(), i * 3));
+  }
+  ASSERT_EQ(A.size(), expected.size());
+  auto it = expected.begin();
+  for (std::size_t i = 0; i < expected.size(); ++i, ++it) {
+    EXPECT_EQ(*A.nth(i), *it);
+    EXPECT_EQ(A.rank(*it), i);
+    EXPECT_EQ(A.count(*it), 1);
+  }
+  EXPECT_EQ(A.rank(5000), expected.size());
+  EXPECT_TRUE(A.IsBalanced());
+  std::size_t common = 0;
+  for (int key : keys_a) common += keys_b.count(key);
+  EXPECT_EQ(C.distance(C.begin(), C.end()),
+            static_cast<std::ptrdiff_t>(common));
+}
+
+TEST(set, extract_and_insert_node) {
+  Tracked::Reset();
+  {
+    ns::set<Tracked> A;
+    ns::set<Tracked> B;
+    for (int i = 0; i < 20; ++i) A.insert(Tracked(i));
+    B.insert(Tracked(5));
+    auto it = std::next(A.begin(), 7);
+    const Tracked* address = &*it;
+    int copies = Tracked::copies;
+
+    auto handle = A.extract(it);
+    ASSERT_FALSE(handle.empty());
+    EXPECT_EQ(handle.value().value, 7);
+    auto result = B.insert(std::move(handle));
+    EXPECT_TRUE(result.inserted);
+    EXPECT_TRUE(result.node.empty());
+    EXPECT_EQ(&*result.position, address);
+
+    auto taken = B.insert(A.extract(Tracked(5)));
+    EXPECT_FALSE(taken.inserted);
+    ASSERT_FALSE(taken.node.empty());
+    EXPECT_EQ((*taken.position).value, 5);
+    EXPECT_EQ(Tracked::copies, copies);
+    EXPECT_TRUE(A.extract(Tracked(100)).empty());
+
+    EXPECT_EQ(A.size(), 18);
+    EXPECT_EQ(B.size(), 2);
+    EXPECT_TRUE(A.IsBalanced());
+    EXPECT_TRUE(B.IsBalanced());
+    EXPECT_EQ(Tracked::alive, 21);
+  }
+  EXPECT_EQ(Tracked::alive, 0);
+}
+
+namespace {
+
+// Counts constructions, to check that lookups by int build no keys.
+struct CountedKey {
+  static inline int made = 0;
+  explicit CountedKey(int v) : value(v) { ++made; }
+  CountedKey(const CountedKey& other) : value(other.value) { ++made; }
+  int value;
+};
+
+struct CountedKeyLess {
+  using is_transparent = void;
+  bool operator()(const CountedKey& a, const CountedKey& b) const {
+    return a.value < b.value;
+  }
+  bool operator()(const CountedKey& a, int b) const { return a.value < b; }
+  bool operator()(int a, const CountedKey& b) const { return a < b.value; }
+};
+
+}  // namespace
+
+TEST(set, transparent_lookup) {
+  ns::set<CountedKey, CountedKeyLess> A;
+  for (int i = 0; i < 50; ++i) A.insert(CountedKey(i * 2));
+  CountedKey::made = 0;
+  EXPECT_EQ((*A.find(42)).value, 42);
+  EXPECT_TRUE(A.find(43) == A.end());
+  EXPECT_TRUE(A.contains(10));
+  EXPECT_FALSE(A.contains(11));
+  EXPECT_EQ(A.count(98), 1);
+  EXPECT_EQ(CountedKey::made, 0);
+}
+
+namespace {
+
+// Counts every comparator call, through operator() or compare().
+struct CountingLess {
+  static inline int calls = 0;
+  bool operator()(const std::string& a, const std::string& b) const {
+    ++calls;
+    return a < b;
+  }
+};
+
+struct CountingThreeWay : CountingLess {
+  int compare(const std::string& a, const std::string& b) const {
+    ++calls;
+    return a.compare(b);
+  }
+};
+
+template <typename Compare>
+int LookupCalls(const std::vector<std::string>& keys) {
+  ns::set<std::string, Compare> A;
+  for (const std::string& key : keys) A.insert(key);
+  CountingLess::calls = 0;
+  for (const std::string& key : keys) {
+    if (!A.contains(key)) ADD_FAILURE() << key;
+    if (A.insert(key).second) ADD_FAILURE() << key;
+  }
+  return CountingLess::calls;
+}
+
+}  // namespace
+
+TEST(set, three_way_comparator) {
+  std::vector<std::string> keys;
+  for (int key : RandomKeys(1000, 100000, 5))
+    keys.push_back("key-" + std::to_string(key * 7919 % 100000));
+  int plain = LookupCalls<CountingLess>(keys);
+  int three_way = LookupCalls<CountingThreeWay>(keys);
+  EXPECT_LT(three_way * 3, plain * 2);
+
+  ns::set<std::string, ns::three_way_less<std::string>> A;
+  std::set<std::string> B;
+  for (const std::string& key : keys) {
+    A.insert(key);
+    B.insert(key);
+  }
+  EXPECT_TRUE(A.insert(keys[0]).second == false);
+  EXPECT_EQ(A.size(), B.size());
+  EXPECT_TRUE(std::equal(B.begin(), B.end(), A.begin()));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(set, emplace_in_place) {
+  Tracked::Reset();
+  {
+    ns::set<Tracked> A;
+    EXPECT_TRUE(A.emplace(3).second);
+    EXPECT_TRUE(A.emplace_hint(A.cend(), 5) != A.end());
+    EXPECT_EQ(Tracked::created, 2);
+    EXPECT_FALSE(A.emplace(3).second);
+    EXPECT_EQ(Tracked::alive, 2);
+    Tracked value(7);
+    EXPECT_TRUE(A.insert(std::move(value)).second);
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(Tracked::moves, 1);
+    EXPECT_EQ(A.size(), 3);
+  }
+  EXPECT_EQ(Tracked::alive, 0);
+}
+
+TEST(set, erase_range) {
+  std::set<int> keys = RandomKeys(2000, 10000, 6);
+  const int ranges[][2] = {{0, 0}, {5, 6}, {10, 40}, {100, 900}, {0, 300},
+                           {1500, -1}, {0, -1}};
+  for (auto range : ranges) {
+    ns::set<int> A(ns::sorted_unique, keys.begin(), keys.end());
+    std::set<int> B(keys);
+    auto first = std::next(A.cbegin(), range[0]);
+    auto last = range[1] < 0 ? A.cend() : std::next(A.cbegin(), range[1]);
+    std::size_t count = std::distance(first, last);
+    auto it = A.erase(first, last);
+    EXPECT_TRUE(it.base() == last.base());
+    B.erase(std::next(B.begin(), range[0]),
+            range[1] < 0 ? B.end() : std::next(B.begin(), range[1]));
+    EXPECT_EQ(A.size(), B.size());
+    EXPECT_EQ(keys.size() - A.size(), count);
+    EXPECT_TRUE(std::equal(B.begin(), B.end(), A.begin()));
+    EXPECT_TRUE(A.IsBalanced());
+  }
+  ns::set<int> C{1, 2, 3};
+  EXPECT_EQ(C.erase(2), 1);
+  EXPECT_EQ(C.erase(2), 0);
+  EXPECT_EQ(C.size(), 2);
+}
+
+TEST(set, erase_if) {
+  std::set<int> keys = RandomKeys(3000, 100000, 7);
+  const int moduli[] = {1, 2, 3, 50, 1000000};
+  for (int modulus : moduli) {
+    using counted =
+        ns::set<int, std::less<int>, ns::allocator<int>, ns::CountedTree>;
+    counted A(ns::sorted_unique, keys.begin(), keys.end());
+    std::set<int> B(keys);
+    auto pred = [modulus](int key) { return key % modulus == 0; };
+    std::size_t erased = A.erase_if(pred);
+    std::size_t expected = 0;
+    for (auto it = B.begin(); it != B.end();)
+      it = pred(*it) ? (++expected, B.erase(it)) : std::next(it);
+    EXPECT_EQ(erased, expected);
+    EXPECT_EQ(A.size(), B.size());
+    EXPECT_TRUE(std::equal(B.begin(), B.end(), A.begin()));
+    EXPECT_TRUE(A.IsBalanced());
+    if (!B.empty()) {
+      EXPECT_EQ(*A.nth(B.size() / 2), *std::next(B.begin(), B.size() / 2));
+    }
+  }
+}
+
+TEST(set, erase_if_throwing_predicate) {
+  std::set<int> keys = RandomKeys(500, 5000, 8);
+  ns::set<int> A(ns::sorted_unique, keys.begin(), keys.end());
+  int calls = 0;
+  auto pred = [&calls](int) {
+    if (++calls == 300) throw std::runtime_error("pred");
+    return true;
+  };
+  EXPECT_THROW(A.erase_if(pred), std::runtime_error);
+  EXPECT_EQ(A.size(), keys.size() - 299);
+  EXPECT_TRUE(std::equal(std::next(keys.begin(), 299), keys.end(), A.begin()));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(set, compact_node_layout) {
+  EXPECT_EQ(sizeof(ns::RBTnodeBase<>), 3 * sizeof(void*));
+  EXPECT_EQ(sizeof(ns::RBTnode<int>), 4 * sizeof(void*));
+  ns::set<int> A;
+  std::set<int> B;
+  for (int key : RandomKeys(2000, 100000, 9)) {
+    A.insert(key);
+    B.insert(key);
+  }
+  for (int key : RandomKeys(1000, 100000, 10)) {
+    A.erase(key);
+    B.erase(key);
+  }
+  EXPECT_TRUE(compare_set(A, B));
+  EXPECT_TRUE(A.IsBalanced());
+}
+
+TEST(set, index_linked_nodes) {
+  using index_set = ns::set<int, std::less<int>, ns::IndexPoolAllocator<int>>;
+  EXPECT_EQ(sizeof(ns::RBTnode<int, ns::IndexLinks>), 16);
+  std::size_t before = ns::IndexArena::in_use();
+  {
+    index_set A;
+    std::set<int> B;
+    for (int key : RandomKeys(3000, 100000, 12)) {
+      A.insert(key);
+      B.insert(key);
+    }
+    for (int key : RandomKeys(1500, 100000, 13)) {
+      A.erase(key);
+      B.erase(key);
+    }
+    EXPECT_TRUE(std::equal(A.begin(), A.end(), B.begin(), B.end()));
+    EXPECT_TRUE(std::equal(std::make_reverse_iterator(A.end()),
+                           std::make_reverse_iterator(A.begin()), B.rbegin(),
+                           B.rend()));
+    EXPECT_TRUE(A.IsBalanced());
+    EXPECT_EQ(ns::IndexArena::in_use() - before, (A.size() + 1) * 16);
+    index_set C(A);
+    index_set D(std::move(C));
+    D.erase_if([](int key) { return key % 3 == 0; });
+    for (int key : B)
+      if (key % 3 == 0) A.erase(key);
+    EXPECT_TRUE(std::equal(A.begin(), A.end(), D.begin(), D.end()));
+    EXPECT_TRUE(C.empty());
+    std::vector<int> keys(1 << 16);
+    for (int i = 0; i < 1 << 16; ++i) keys[i] = i * 3;
+    index_set E(ns::sorted_unique, keys.begin(), keys.end());
+    index_set F(ns::parallel, E);
+    A.swap(F);
+    EXPECT_TRUE(std::equal(A.begin(), A.end(), keys.begin(), keys.end()));
+    EXPECT_TRUE(A.IsBalanced());
+  }
+  EXPECT_EQ(ns::IndexArena::in_use(), before);
+}
+
+TEST(set, for_each_in_order) {
+  std::set<int> keys = RandomKeys(5000, 100000, 11);
+  ns::set<int> A(ns::sorted_unique, keys.begin(), keys.end());
+  std::vector<int> seen;
+  A.for_each([&seen](int key) { seen.push_back(key); });
+  EXPECT_TRUE(std::equal(seen.begin(), seen.end(), keys.begin(), keys.end()));
+  ns::set<int> empty;
+  int calls = 0;
+  empty.for_each([&calls](int) { ++calls; });
+  EXPECT_EQ(calls, 0);
+}
+
+TEST(set, find_batch_matches_find) {
+  std::set<int> keys = RandomKeys(3000, 10000, 12);
+  ns::set<int> A(ns::sorted_unique, keys.begin(), keys.end());
+  std::vector<int> probes;
+  for (int key = -5; key < 10005; key += 3) probes.push_back(key);
+  std::vector<ns::set<int>::iter> found;
+  A.find_batch(probes, std::back_inserter(found));
+  std::vector<bool> present;
+  A.contains_batch(probes, std::back_inserter(present));
+  ASSERT_EQ(found.size(), probes.size());
+  ASSERT_EQ(present.size(), probes.size());
+  for (std::size_t i = 0; i < probes.size(); ++i) {
+    EXPECT_TRUE(found[i] == A.find(probes[i]));
+    EXPECT_EQ(present[i], keys.count(probes[i]) == 1);
+  }
+  ns::set<int> empty;
+  bool flags[3];
+  empty.contains_batch(std::vector<int>{1, 2, 3}, flags);
+  EXPECT_FALSE(flags[0] || flags[1] || flags[2]);
+}
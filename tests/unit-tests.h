@@ -3,12 +3,59 @@
 #include <array>
 #include <iostream>
 #include <list>
+#include <iterator>
 #include <map>
 #include <queue>
 #include <set>
+#include <sstream>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "../containers.h"
 #include "../containersplus.h"
+
+// Counts live instances, copies and moves to check how containers handle
+// their elements.
+struct Tracked {
+  static inline int alive = 0;
+  static inline int created = 0;
+  static inline int copies = 0;
+  static inline int moves = 0;
+
+  static void Reset() { alive = created = copies = moves = 0; }
+
+  Tracked(int v = 0) : value(v) {
+    ++alive;
+    ++created;
+  }
+  Tracked(const Tracked& other) : value(other.value) {
+    ++alive;
+    ++created;
+    ++copies;
+  }
+  Tracked(Tracked&& other) noexcept : value(other.value) {
+    ++alive;
+    ++created;
+    ++moves;
+  }
+  ~Tracked() { --alive; }
+
+  Tracked& operator=(const Tracked& other) {
+    value = other.value;
+    ++copies;
+    return (*this);
+  }
+  Tracked& operator=(Tracked&& other) noexcept {
+    value = other.value;
+    ++moves;
+    return (*this);
+  }
+
+  bool operator==(const Tracked& other) const { return value == other.value; }
+  bool operator<(const Tracked& other) const { return value < other.value; }
+
+  int value;
+};
@@ -415,3 +415,331 @@ TEST(vector, insert_many_back_function) {
     EXPECT_EQ(std_vector1[i], ns_vector1[i]);
   }
 }
+
+TEST(vector, reserve_moves_elements) {
+  Tracked::Reset();
+  {
+    ns::vector<Tracked> ns_vector;
+    for (int i = 0; i < 100; ++i) ns_vector.push_back(Tracked(i));
+    int copies = Tracked::copies;
+    ns_vector.reserve(1000);
+    EXPECT_EQ(Tracked::copies, copies);
+    EXPECT_EQ(Tracked::alive, 100);
+    ns_vector.shrink_to_fit();
+    EXPECT_EQ(Tracked::copies, copies);
+    EXPECT_EQ(Tracked::alive, 100);
+    for (int i = 0; i < 100; ++i) EXPECT_EQ(ns_vector[i].value, i);
+  }
+  EXPECT_EQ(Tracked::alive, 0);
+}
+
+TEST(vector, reserve_strings) {
+  std::vector<std::string> std_vector;
+  ns::vector<std::string> ns_vector;
+  for (int i = 0; i < 1000; ++i) {
+    std_vector.push_back(std::string(40, 'a' + i % 26));
+    ns_vector.push_back(std::string(40, 'a' + i % 26));
+  }
+  ns_vector.shrink_to_fit();
+  for (int i = 0; i < 1000; ++i) EXPECT_EQ(std_vector[i], ns_vector[i]);
+}
+
+TEST(vector, hysteresis_shrink) {
+  ns::vector<int> ns_vector;
+  for (int i = 0; i < 64; ++i) ns_vector.push_back(i);
+  EXPECT_EQ(ns_vector.capacity(), 64);
+
+  for (int i = 0; i < 1000; ++i) {
+    ns_vector.pop_back();
+    ns_vector.push_back(i);
+  }
+  EXPECT_EQ(ns_vector.capacity(), 64);
+
+  while (ns_vector.size() > 16) ns_vector.pop_back();
+  EXPECT_EQ(ns_vector.capacity(), 64);
+  ns_vector.pop_back();
+  EXPECT_EQ(ns_vector.capacity(), 32);
+  for (int i = 0; i < 1000; ++i) {
+    ns_vector.push_back(i);
+    ns_vector.pop_back();
+  }
+  EXPECT_EQ(ns_vector.capacity(), 32);
+}
+
+TEST(vector, no_shrink_growth) {
+  ns::vector<int, ns::LinearAllocator<int>, ns::NoShrinkGrowth<3, 2>> ns_vector;
+  for (int i = 0; i < 10; ++i) ns_vector.push_back(i);
+  EXPECT_EQ(ns_vector.capacity(), 13);
+
+  while (!ns_vector.empty()) ns_vector.pop_back();
+  EXPECT_EQ(ns_vector.capacity(), 13);
+
+  ns_vector.trim();
+  EXPECT_EQ(ns_vector.capacity(), 0);
+}
+
+template <typename T>
+struct CountingAllocator : ns::allocator<T> {
+  static inline int allocations = 0;
+
+  CountingAllocator() {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    ++allocations;
+    return ns::allocator<T>::allocate(n);
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = CountingAllocator<U>;
+  };
+};
+
+TEST(vector, stack_steady_state) {
+  ns::stack<int, ns::vector<int, CountingAllocator<int>>> ns_stack;
+  for (int i = 0; i < 1024; ++i) ns_stack.push(i);
+  for (int i = 0; i < 512; ++i) ns_stack.pop();
+  for (int i = 0; i < 512; ++i) ns_stack.push(i);
+  CountingAllocator<int>::allocations = 0;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 512; ++i) ns_stack.pop();
+    for (int i = 0; i < 512; ++i) ns_stack.push(i);
+  }
+  EXPECT_EQ(CountingAllocator<int>::allocations, 0);
+  EXPECT_EQ(ns_stack.size(), 1024);
+  EXPECT_EQ(ns_stack.top(), 511);
+}
+
+TEST(vector, insert_erase_strings) {
+  std::vector<std::string> std_vector;
+  ns::vector<std::string> ns_vector;
+  for (int i = 0; i < 200; ++i) {
+    std::string str(30, 'a' + i % 26);
+    std_vector.insert(std_vector.begin() + std_vector.size() / 2, str);
+    ns_vector.insert(ns_vector.begin() + ns_vector.size() / 2, str);
+  }
+  std_vector.insert(std_vector.begin() + 3, 5, "gap");
+  ns_vector.insert(ns_vector.begin() + 3, 5, "gap");
+  std_vector.erase(std_vector.begin() + 10, std_vector.begin() + 60);
+  ns_vector.erase(ns_vector.begin() + 10, ns_vector.begin() + 60);
+  std_vector.erase(std_vector.begin());
+  ns_vector.erase(ns_vector.begin());
+
+  ASSERT_EQ(std_vector.size(), ns_vector.size());
+  for (size_t i = 0; i < std_vector.size(); ++i)
+    EXPECT_EQ(std_vector[i], ns_vector[i]);
+}
+
+TEST(vector, insert_erase_keep_objects_balanced) {
+  Tracked::Reset();
+  {
+    ns::vector<Tracked> ns_vector;
+    for (int i = 0; i < 50; ++i) ns_vector.insert(ns_vector.begin(), i);
+    ns_vector.insert(ns_vector.begin() + 45, 10, Tracked(-1));
+    EXPECT_EQ(Tracked::alive, 60);
+    ns_vector.erase(ns_vector.begin() + 5, ns_vector.begin() + 25);
+    EXPECT_EQ(Tracked::alive, 40);
+    EXPECT_EQ(ns_vector[0].value, 49);
+    EXPECT_EQ(ns_vector[5].value, 24);
+  }
+  EXPECT_EQ(Tracked::alive, 0);
+}
+
+TEST(vector, front_insert_deep) {
+  ns::vector<int> ns_vector;
+  for (int i = 0; i < 20000; ++i) ns_vector.insert(ns_vector.begin(), i);
+  EXPECT_EQ(ns_vector.front(), 19999);
+  EXPECT_EQ(ns_vector.back(), 0);
+  ns_vector.erase(ns_vector.begin(), ns_vector.begin() + 19999);
+  EXPECT_EQ(ns_vector.size(), 1);
+  EXPECT_EQ(ns_vector.front(), 0);
+}
+
+TEST(vector, emplace_back_function) {
+  std::vector<std::pair<int, std::string>> std_vector;
+  ns::vector<std::pair<int, std::string>> ns_vector;
+  for (int i = 0; i < 20; ++i) {
+    std_vector.emplace_back(i, std::string(i, 'x'));
+    ns_vector.emplace_back(i, std::string(i, 'x'));
+  }
+  EXPECT_EQ(std_vector.size(), ns_vector.size());
+  EXPECT_EQ(std_vector.capacity(), ns_vector.capacity());
+  for (int i = 0; i < 20; ++i) EXPECT_EQ(std_vector[i], ns_vector[i]);
+
+  ns::vector<std::string> ns_vector2 = {"a", "b", "c", "d"};
+  ns_vector2.emplace_back(ns_vector2[0]);
+  EXPECT_EQ(ns_vector2.back(), "a");
+}
+
+TEST(vector, emplace_function) {
+  std::vector<std::string> std_vector = {"a", "b", "c"};
+  ns::vector<std::string> ns_vector = {"a", "b", "c"};
+
+  auto std_pos = std_vector.emplace(std_vector.begin() + 1, 3, 'z');
+  auto ns_pos = ns_vector.emplace(ns_vector.begin() + 1, 3, 'z');
+  EXPECT_EQ(*std_pos, *ns_pos);
+
+  std_vector.emplace(std_vector.begin(), std_vector[2]);
+  ns_vector.emplace(ns_vector.begin(), ns_vector[2]);
+  std_vector.emplace(std_vector.end(), "end");
+  ns_vector.emplace(ns_vector.end(), "end");
+
+  ASSERT_EQ(std_vector.size(), ns_vector.size());
+  for (size_t i = 0; i < std_vector.size(); ++i)
+    EXPECT_EQ(std_vector[i], ns_vector[i]);
+}
+
+// Throws from the copy or move that brings countdown down to zero.
+struct Fragile {
+  static inline int alive = 0;
+  static inline int countdown = 0;
+
+  explicit Fragile(int v) : value(v) { ++alive; }
+  Fragile(const Fragile& other) : value(other.value) {
+    Tick();
+    ++alive;
+  }
+  Fragile(Fragile&& other) noexcept(false) : value(other.value) {
+    Tick();
+    ++alive;
+  }
+  ~Fragile() { --alive; }
+  Fragile& operator=(const Fragile&) = default;
+  Fragile& operator=(Fragile&&) = default;
+
+  static void Tick() {
+    if (countdown > 0 && --countdown == 0) throw std::runtime_error("tick");
+  }
+
+  int value;
+};
+
+struct FragileMoveOnly : Fragile {
+  explicit FragileMoveOnly(int v) : Fragile(v) {}
+  FragileMoveOnly(const FragileMoveOnly&) = delete;
+  FragileMoveOnly(FragileMoveOnly&&) = default;
+  FragileMoveOnly& operator=(FragileMoveOnly&&) = default;
+};
+
+TEST(vector, reallocating_insert_throws_cleanly) {
+  Fragile::alive = 0;
+  {
+    ns::vector<Fragile> ns_vector;
+    ns_vector.reserve(4);
+    for (int i = 0; i < 4; ++i) ns_vector.emplace_back(i);
+    Fragile extra(9);
+    for (int fail = 1; fail <= 5; ++fail) {
+      Fragile::countdown = fail;
+      EXPECT_THROW(ns_vector.insert(ns_vector.begin() + 2, extra),
+                   std::runtime_error);
+      ASSERT_EQ(ns_vector.size(), 4);
+      for (int i = 0; i < 4; ++i) EXPECT_EQ(ns_vector[i].value, i);
+      EXPECT_EQ(Fragile::alive, 5);
+    }
+    Fragile::countdown = 0;
+    ns_vector.insert(ns_vector.begin() + 2, extra);
+    EXPECT_EQ(ns_vector[2].value, 9);
+  }
+  EXPECT_EQ(Fragile::alive, 0);
+
+  {
+    ns::vector<FragileMoveOnly> ns_vector;
+    ns_vector.reserve(4);
+    for (int i = 0; i < 4; ++i) ns_vector.emplace_back(i);
+    for (int fail = 1; fail <= 4; ++fail) {
+      Fragile::countdown = fail;
+      EXPECT_THROW(ns_vector.emplace(ns_vector.begin() + 2, 9),
+                   std::runtime_error);
+      EXPECT_EQ(ns_vector.size(), 4);
+      EXPECT_EQ(Fragile::alive, 4);
+    }
+  }
+  EXPECT_EQ(Fragile::alive, 0);
+}
+
+TEST(vector, rvalue_insert_does_not_copy) {
+  Tracked::Reset();
+  {
+    ns::vector<Tracked> ns_vector;
+    for (int i = 0; i < 10; ++i) ns_vector.push_back(Tracked(i));
+    ns_vector.emplace_back(10);
+    ns_vector.insert(ns_vector.begin() + 2, Tracked(-1));
+    ns_vector.emplace(ns_vector.begin(), -2);
+    ns_vector.insert_many_back(Tracked(11), Tracked(12));
+    ns_vector.insert_many(ns_vector.begin() + 1, Tracked(-3), Tracked(-4));
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(ns_vector.size(), 17);
+    EXPECT_EQ(ns_vector[0].value, -2);
+    EXPECT_EQ(ns_vector[1].value, -3);
+    EXPECT_EQ(ns_vector[2].value, -4);
+    EXPECT_EQ(ns_vector[5].value, -1);
+    EXPECT_EQ(ns_vector.back().value, 12);
+  }
+  EXPECT_EQ(Tracked::alive, 0);
+}
+
+TEST(vector, range_constructor) {
+  std::list<std::string> source = {"one", "two", "three", "four"};
+  std::vector<std::string> std_vector(source.begin(), source.end());
+  ns::vector<std::string> ns_vector(source.begin(), source.end());
+
+  ASSERT_EQ(std_vector.size(), ns_vector.size());
+  EXPECT_EQ(std_vector.capacity(), ns_vector.capacity());
+  for (size_t i = 0; i < std_vector.size(); ++i)
+    EXPECT_EQ(std_vector[i], ns_vector[i]);
+
+  ns::vector<std::string> ns_vector2(ns_vector.begin() + 1, ns_vector.end());
+  EXPECT_EQ(ns_vector2.size(), 3);
+  EXPECT_EQ(ns_vector2.front(), "two");
+}
+
+TEST(vector, range_insert) {
+  std::vector<int> std_vector = {1, 2, 3, 4, 5};
+  ns::vector<int> ns_vector = {1, 2, 3, 4, 5};
+  std::vector<int> source = {10, 20, 30};
+
+  auto std_pos =
+      std_vector.insert(std_vector.begin() + 2, source.begin(), source.end());
+  auto ns_pos =
+      ns_vector.insert(ns_vector.begin() + 2, source.begin(), source.end());
+  EXPECT_EQ(*std_pos, *ns_pos);
+
+  std_vector.insert(std_vector.begin(), {7, 8});
+  ns_vector.insert(ns_vector.begin(), {7, 8});
+  std_vector.insert(std_vector.end(), source.begin(), source.begin());
+  ns_vector.insert(ns_vector.end(), source.begin(), source.begin());
+
+  std::istringstream stream("40 50 60");
+  std_vector.insert(std_vector.begin() + 1, std::istream_iterator<int>(stream),
+                    std::istream_iterator<int>());
+  stream.clear();
+  stream.str("40 50 60");
+  ns_vector.insert(ns_vector.begin() + 1, std::istream_iterator<int>(stream),
+                   std::istream_iterator<int>());
+
+  ASSERT_EQ(std_vector.size(), ns_vector.size());
+  for (size_t i = 0; i < std_vector.size(); ++i)
+    EXPECT_EQ(std_vector[i], ns_vector[i]);
+}
+
+TEST(vector, assign_function) {
+  std::vector<std::string> source = {"a", "b", "c", "d", "e", "f"};
+  ns::vector<std::string> ns_vector = {"x", "y"};
+
+  ns_vector.assign(source.begin(), source.end());
+  EXPECT_EQ(ns_vector.size(), 6);
+  EXPECT_EQ(ns_vector.capacity(), 6);
+  for (size_t i = 0; i < source.size(); ++i) EXPECT_EQ(source[i], ns_vector[i]);
+
+  ns_vector.assign(source.begin(), source.begin() + 2);
+  EXPECT_EQ(ns_vector.size(), 2);
+  EXPECT_EQ(ns_vector.capacity(), 6);
+  EXPECT_EQ(ns_vector.back(), "b");
+
+  const ns::vector<std::string> ns_const = {"c1", "c2", "c3"};
+  ns_vector = ns_const;
+  EXPECT_EQ(ns_vector.size(), 3);
+  EXPECT_EQ(ns_vector[2], "c3");
+}
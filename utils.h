@@ -171,6 +171,26 @@ struct is_pair : false_type {};
 template <typename T1, typename T2>
 struct is_pair<ns::pair<T1, T2> > : true_type {};
 
+// Constructor tags for input already sorted by the container's comparator:
+// sorted_unique for set and map, sorted_equivalent for multiset.
+struct sorted_unique_t {
+  explicit sorted_unique_t() = default;
+};
+inline constexpr sorted_unique_t sorted_unique{};
+
+struct sorted_equivalent_t {
+  explicit sorted_equivalent_t() = default;
+};
+inline constexpr sorted_equivalent_t sorted_equivalent{};
+
+// Opts an operation on a large tree into running on several threads. Only
+// for stateless allocators; element copies and comparisons then run
+// concurrently and must not share mutable state.
+struct parallel_t {
+  explicit parallel_t() = default;
+};
+inline constexpr parallel_t parallel{};
+
 }  // namespace ns
 
 #endif  // UTILS_H_
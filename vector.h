@@ -1,18 +1,29 @@
 #ifndef VECTOR_H_
 #define VECTOR_H_
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include "allocator.h"
 #include "compare.h"
+#include "growth.h"
+#include "iterator.h"
 #include "utils.h"
 
 namespace ns {
 
-template <typename T, typename Allocator = ns::LinearAllocator<T>>
+template <typename T, typename Allocator = ns::allocator<T>,
+          typename GrowthPolicy = ns::HysteresisGrowth<>>
 class vector {
  public:
   using value_type = T;
   using pointer = value_type*;
   using const_pointer = const value_type*;
   using allocator_type = Allocator;
+  using growth_policy = GrowthPolicy;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
   using reference = value_type&;
@@ -52,49 +63,79 @@ class vector {
     }
   }
 
+  template <typename InputIt,
+            typename = typename ns::enable_if<
+                !ns::is_integral<InputIt>::value>::type>
+  vector(InputIt first, InputIt last,
+         const allocator_type& alloc = allocator_type())
+      : alloc_(alloc), ptr_(nullptr), cap_(0), size_(0) {
+    assign(first, last);
+  }
+
   vector(const vector& other)
-      : alloc_(other.alloc_),
-        ptr_(alloc_.allocate(other.cap_)),
+      : vector(other,
+               alloc_traits::select_on_container_copy_construction(
+                   other.alloc_)){};
+
+  vector(const vector& other, const allocator_type& alloc)
+      : alloc_(alloc),
+        ptr_(other.cap_ > 0 ? alloc_.allocate(other.cap_) : nullptr),
         cap_(other.cap_),
         size_(other.size_) {
     for (size_type i = 0; i < size_; i++) alloc_.construct(ptr_ + i, other[i]);
   };
 
-  vector(vector&& other) : ptr_(nullptr), cap_(0), size_(0) {
-    std::swap(alloc_, other.alloc_);
-    std::swap(ptr_, other.ptr_);
-    std::swap(cap_, other.cap_);
-    std::swap(size_, other.size_);
+  vector(vector&& other)
+      : alloc_(other.alloc_), ptr_(nullptr), cap_(0), size_(0) {
+    Steal(other);
   };
 
-  ~vector() {
-    clear();
-    if (cap_ > 0) alloc_.deallocate(ptr_, cap_);
+  vector(vector&& other, const allocator_type& alloc)
+      : alloc_(alloc), ptr_(nullptr), cap_(0), size_(0) {
+    if (alloc_ == other.alloc_)
+      Steal(other);
+    else
+      assign(std::make_move_iterator(other.begin()),
+             std::make_move_iterator(other.end()));
   };
 
+  ~vector() { Release(); };
+
   vector& operator=(vector& other) {
-    if (this != &other) {
-      clear();
-      Assign(other.begin(), other.end());
-    }
-    return (*this);
+    return (*this = static_cast<const vector&>(other));
   }
 
   vector& operator=(const vector& other) {
-    if (this != &other) {
-      clear();
-      Assign(other.cbegin(), other.cend());
+    if (this == &other) return (*this);
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::
+                      value) {
+      if (alloc_ != other.alloc_) {
+        Release();
+        alloc_ = other.alloc_;
+      }
     }
+    assign(other.cbegin(), other.cend());
     return (*this);
   }
 
   vector& operator=(vector&& other) {
-    if (this != &other) {
-      swap(other);
+    if (this == &other) return (*this);
+    if (alloc_traits::propagate_on_container_move_assignment::value ||
+        alloc_traits::is_always_equal::value || alloc_ == other.alloc_) {
+      Release();
+      if constexpr (alloc_traits::propagate_on_container_move_assignment::
+                        value)
+        alloc_ = other.alloc_;
+      Steal(other);
+    } else {
+      assign(std::make_move_iterator(other.begin()),
+             std::make_move_iterator(other.end()));
     }
     return (*this);
   }
 
+  allocator_type get_allocator() const { return alloc_; }
+
   reference at(size_type pos) {
     if (pos >= size()) throw std::out_of_range("out of range");
     return ptr_[pos];
@@ -134,8 +175,8 @@ class vector {
   iter begin() { return (iter(ptr_)); }
   iter end() { return (iter(ptr_ + size_)); }
 
-  const_iter cbegin() { return (const_iter(ptr_)); }
-  const_iter cend() { return (const_iter(ptr_ + size_)); }
+  const_iter cbegin() const { return (const_iter(ptr_)); }
+  const_iter cend() const { return (const_iter(ptr_ + size_)); }
 
   bool empty() const { return (!size()); }
 
@@ -147,26 +188,17 @@ class vector {
     if (size > max_size()) {
       throw(std::length_error("too much"));
     } else if (size > cap_) {
-      pointer new_ptr = alloc_.allocate(size);
-      for (size_type i = 0; i < size_; ++i)
-        alloc_.construct(new_ptr + i, *(ptr_ + i));
-      alloc_.deallocate(ptr_, cap_);
-      ptr_ = new_ptr;
-      cap_ = size;
+      Reallocate(size);
     }
   }
 
   size_type capacity() const { return (cap_); }
 
-  void shrink_to_fit() {
-    if (cap_ - size_ > 0) {
-      pointer new_ptr = alloc_.allocate(size_);
-      for (size_type i = 0; i < size_; ++i)
-        alloc_.construct(new_ptr + i, *(ptr_ + i));
-      alloc_.deallocate(ptr_, cap_);
-      ptr_ = new_ptr;
-      cap_ = size_;
-    }
+  void shrink_to_fit() { trim(); }
+
+  // Releases all unused capacity regardless of the growth policy.
+  void trim() {
+    if (cap_ > size_) Reallocate(size_);
   }
 
   void clear() {
@@ -176,85 +208,132 @@ class vector {
     }
   }
 
-  iter insert(iter pos, const value_type& val) {
-    size_type idx = pos - begin();
-    reserve(size_ + 1);
-    pos = begin() + idx;
-    ShiftBack(pos);
-    alloc_.construct(&(*pos), val);
-    size_++;
-    return (pos);
+  iter insert(iter pos, const value_type& val) { return emplace(pos, val); }
+
+  iter insert(iter pos, value_type&& val) {
+    return emplace(pos, std::move(val));
   }
 
   void insert(iter pos, size_type n, const value_type& val) {
     size_type idx = pos - begin();
-    reserve(size_ + n);
-    pos = begin() + idx;
-    ShiftBack(pos, n);
-    for (size_type i = 0; i < n; ++i) alloc_.construct(&(*(pos + i)), val);
+    if (size_ + n > cap_) {
+      ReallocateInsert(idx, n, [&](pointer dest) {
+        for (size_type i = 0; i < n; ++i) alloc_.construct(dest + i, val);
+      });
+      return;
+    }
+    value_type tmp(val);
+    OpenGap(idx, n);
+    for (size_type i = 0; i < n; ++i) alloc_.construct(ptr_ + idx + i, tmp);
     size_ += n;
   }
 
+  // Inserts [first, last) with one reservation and one shift of the tail.
+  // The range must not come from this vector.
+  template <typename InputIt,
+            typename = typename ns::enable_if<
+                !ns::is_integral<InputIt>::value>::type>
+  iter insert(iter pos, InputIt first, InputIt last) {
+    size_type idx = pos - begin();
+    InsertRange(idx, first, last,
+                typename std::iterator_traits<InputIt>::iterator_category());
+    return (begin() + idx);
+  }
+
+  iter insert(iter pos, std::initializer_list<value_type> list) {
+    return insert(pos, list.begin(), list.end());
+  }
+
+  template <typename... Args>
+  iter emplace(iter pos, Args&&... args) {
+    size_type idx = pos - begin();
+    if (size_ == cap_) {
+      ReallocateInsert(idx, 1, [&](pointer dest) {
+        alloc_.construct(dest, std::forward<Args>(args)...);
+      });
+    } else if (idx == size_) {
+      alloc_.construct(ptr_ + size_, std::forward<Args>(args)...);
+      size_++;
+    } else {
+      value_type tmp(std::forward<Args>(args)...);
+      OpenGap(idx, 1);
+      alloc_.construct(ptr_ + idx, std::move(tmp));
+      size_++;
+    }
+    return (begin() + idx);
+  }
+
+  template <typename... Args>
+  reference emplace_back(Args&&... args) {
+    if (size_ == cap_) {
+      ReallocateInsert(size_, 1, [&](pointer dest) {
+        alloc_.construct(dest, std::forward<Args>(args)...);
+      });
+    } else {
+      alloc_.construct(ptr_ + size_, std::forward<Args>(args)...);
+      size_++;
+    }
+    return ptr_[size_ - 1];
+  }
+
   template <typename... Args>
   void insert_many_back(Args&&... args) {
-    (push_back(args), ...);
+    (emplace_back(std::forward<Args>(args)), ...);
   }
 
   template <typename... Args>
   iter insert_many(iter pos, Args&&... args) {
-    vector<value_type> temp{args...};
-    iter insert_pos = pos;
-    for (size_t i = 0; i < temp.size(); ++i, ++insert_pos) {
-      insert_pos = insert(insert_pos, temp[i]);
+    constexpr size_type n = sizeof...(Args);
+    if constexpr (n == 0) {
+      return pos;
+    } else {
+      size_type idx = pos - begin();
+      auto fill = [&](pointer dest) {
+        (alloc_.construct(dest++, std::forward<Args>(args)), ...);
+      };
+      if (size_ + n > cap_) {
+        ReallocateInsert(idx, n, fill);
+      } else if (idx == size_) {
+        fill(ptr_ + size_);
+        size_ += n;
+      } else {
+        value_type tmp[] = {value_type(std::forward<Args>(args))...};
+        OpenGap(idx, n);
+        for (size_type i = 0; i < n; ++i)
+          alloc_.construct(ptr_ + idx + i, std::move(tmp[i]));
+        size_ += n;
+      }
+      return (begin() + idx + n);
     }
-    return insert_pos;
   }
 
   iter erase(iter pos) {
     if (empty()) return end();
-    iter it = pos;
-    alloc_.destroy(&(*it));
-    iter next_it = it + 1;
-    while (next_it != end()) {
-      alloc_.construct(&(*it), *next_it);
-      it++;
-      next_it++;
-    }
-    pop_back();
-    return pos;
+    return erase(pos, pos + 1);
   }
 
   iter erase(iter first, iter last) {
     if (empty()) return (end());
-    iter it = begin();
-    iter itb = first;
-    difference_type dist = last - first;
-    while (it != first) it++;
-    for (; first != last; ++first) alloc_.destroy(&(*first));
-    while (it + dist != end()) {
-      alloc_.construct(&(*it), *(it + dist));
-      it++;
-    }
-    while (dist-- > 0) pop_back();
-    return itb;
+    size_type idx = first - begin();
+    CloseGap(idx, last - first);
+    Shrink();
+    return (begin() + idx);
   }
 
-  void push_back(const_reference val) {
-    if (size_ == cap_) empty() ? reserve(1) : reserve(size_ * 2);
-    alloc_.construct(ptr_ + size_, val);
-    size_++;
-  }
+  void push_back(const_reference val) { emplace_back(val); }
+
+  void push_back(value_type&& val) { emplace_back(std::move(val)); }
 
   void pop_back() {
     if (size_ == 0) return;
     alloc_.destroy(ptr_ + size_ - 1);
     size_--;
-    if (size_ < cap_ / 2) {
-      reserve(cap_ / 2);
-    }
+    Shrink();
   }
 
   void swap(vector& other) {
+    if constexpr (alloc_traits::propagate_on_container_swap::value)
+      std::swap(alloc_, other.alloc_);
     std::swap(ptr_, other.ptr_);
     std::swap(cap_, other.cap_);
     std::swap(size_, other.size_);
@@ -270,25 +349,219 @@ class vector {
     }
   }
 
-  void Assign(iter begin, iter end) {
+  // Replaces the contents with [first, last), allocating at most once.
+  template <typename InputIt,
+            typename = typename ns::enable_if<
+                !ns::is_integral<InputIt>::value>::type>
+  void assign(InputIt first, InputIt last) {
     clear();
-    for (iter it = begin; it != end; ++it) {
-      push_back(*it);
-    }
+    AssignRange(first, last,
+                typename std::iterator_traits<InputIt>::iterator_category());
   }
 
+  void Assign(iter begin, iter end) { assign(begin, end); }
+
   void PushFront(const_reference val) { insert(begin(), val); }
 
+  void PushFront(value_type&& val) { insert(begin(), std::move(val)); }
+
  private:
+  using alloc_traits = std::allocator_traits<allocator_type>;
+
   allocator_type alloc_;
   pointer ptr_;
   size_type cap_;
   size_type size_;
 
-  void ShiftBack(iter pos, size_type n = 1) {
-    if (pos == end()) return;
-    ShiftBack(pos + 1, n);
-    alloc_.construct(&(*(pos + n)), *pos);
+  void Shrink() {
+    size_type target = growth_policy::shrink(size_, cap_);
+    if (target < cap_) Reallocate(target < size_ ? size_ : target);
+  }
+
+  void Steal(vector& other) {
+    ptr_ = other.ptr_;
+    cap_ = other.cap_;
+    size_ = other.size_;
+    other.ptr_ = nullptr;
+    other.cap_ = 0;
+    other.size_ = 0;
+  }
+
+  void Release() {
+    clear();
+    if (cap_ > 0) alloc_.deallocate(ptr_, cap_);
+    ptr_ = nullptr;
+    cap_ = 0;
+  }
+
+  template <typename InputIt>
+  void AssignRange(InputIt first, InputIt last, std::input_iterator_tag) {
+    for (; first != last; ++first) emplace_back(*first);
+  }
+
+  template <typename ForwardIt>
+  void AssignRange(ForwardIt first, ForwardIt last,
+                   std::forward_iterator_tag) {
+    size_type n = std::distance(first, last);
+    if (n > cap_) {
+      if (n > max_size()) throw(std::length_error("too much"));
+      if (cap_ > 0) alloc_.deallocate(ptr_, cap_);
+      ptr_ = nullptr;
+      cap_ = 0;
+      ptr_ = alloc_.allocate(n);
+      cap_ = n;
+    }
+    for (; first != last; ++first, ++size_)
+      alloc_.construct(ptr_ + size_, *first);
+  }
+
+  // Single-pass ranges are appended and rotated into place, which still
+  // shifts the tail only once.
+  template <typename InputIt>
+  void InsertRange(size_type idx, InputIt first, InputIt last,
+                   std::input_iterator_tag) {
+    size_type old_size = size_;
+    for (; first != last; ++first) emplace_back(*first);
+    std::rotate(ptr_ + idx, ptr_ + old_size, ptr_ + size_);
+  }
+
+  template <typename ForwardIt>
+  void InsertRange(size_type idx, ForwardIt first, ForwardIt last,
+                   std::forward_iterator_tag) {
+    size_type n = std::distance(first, last);
+    if (n == 0) return;
+    auto fill = [&](pointer dest) {
+      for (; first != last; ++first) alloc_.construct(dest++, *first);
+    };
+    if (size_ + n > cap_) {
+      ReallocateInsert(idx, n, fill);
+    } else {
+      OpenGap(idx, n);
+      fill(ptr_ + idx);
+      size_ += n;
+    }
+  }
+
+  // Moves the elements into a bigger buffer that has n slots free at idx.
+  // construct(dest) fills those slots before the old elements are moved, so
+  // arguments referring into the vector are still valid while it runs.
+  template <typename Construct>
+  void ReallocateInsert(size_type idx, size_type n, Construct construct) {
+    size_type new_cap = growth_policy::grow(cap_, size_ + n);
+    if (new_cap > max_size()) throw(std::length_error("too much"));
+    pointer new_ptr = alloc_.allocate(new_cap);
+    try {
+      construct(new_ptr + idx);
+    } catch (...) {
+      alloc_.deallocate(new_ptr, new_cap);
+      throw;
+    }
+    try {
+      MoveInto(ptr_, ptr_ + idx, new_ptr);
+      try {
+        MoveInto(ptr_ + idx, ptr_ + size_, new_ptr + idx + n);
+      } catch (...) {
+        Destroy(new_ptr, new_ptr + idx);
+        throw;
+      }
+    } catch (...) {
+      Destroy(new_ptr + idx, new_ptr + idx + n);
+      alloc_.deallocate(new_ptr, new_cap);
+      throw;
+    }
+    Destroy(ptr_, ptr_ + size_);
+    if (cap_ > 0) alloc_.deallocate(ptr_, cap_);
+    ptr_ = new_ptr;
+    cap_ = new_cap;
+    size_ += n;
+  }
+
+  // Moves the elements into a fresh buffer of new_cap slots and releases the
+  // old one. Trivially copyable types are relocated with a single memcpy.
+  void Reallocate(size_type new_cap) {
+    pointer new_ptr = new_cap > 0 ? alloc_.allocate(new_cap) : nullptr;
+    try {
+      Relocate(ptr_, ptr_ + size_, new_ptr);
+    } catch (...) {
+      alloc_.deallocate(new_ptr, new_cap);
+      throw;
+    }
+    if (cap_ > 0) alloc_.deallocate(ptr_, cap_);
+    ptr_ = new_ptr;
+    cap_ = new_cap;
+  }
+
+  // Constructs [first, last) at dest and destroys the source range. A
+  // throwing copy (types without a noexcept move) leaves the source intact.
+  void Relocate(pointer first, pointer last, pointer dest) {
+    MoveInto(first, last, dest);
+    Destroy(first, last);
+  }
+
+  // Constructs [first, last) at dest, moving only when that cannot throw.
+  // On failure the part already built is destroyed again.
+  void MoveInto(pointer first, pointer last, pointer dest) {
+    if (first == last) return;
+    if constexpr (std::is_trivially_copyable<value_type>::value) {
+      std::memcpy(static_cast<void*>(dest), static_cast<const void*>(first),
+                  (last - first) * sizeof(value_type));
+    } else {
+      pointer curr = dest;
+      try {
+        for (pointer it = first; it != last; ++it, ++curr)
+          alloc_.construct(curr, std::move_if_noexcept(*it));
+      } catch (...) {
+        Destroy(dest, curr);
+        throw;
+      }
+    }
+  }
+
+  void Destroy(pointer first, pointer last) {
+    if constexpr (!std::is_trivially_destructible<value_type>::value)
+      for (; first != last; ++first) alloc_.destroy(first);
+  }
+
+  // Shifts [idx, size_) back by n slots, leaving [idx, idx + n) as raw
+  // memory for the caller to construct into. size_ is not updated.
+  void OpenGap(size_type idx, size_type n) {
+    pointer first = ptr_ + idx;
+    pointer last = ptr_ + size_;
+    if (first == last || n == 0) return;
+    if constexpr (std::is_trivially_copyable<value_type>::value) {
+      std::memmove(static_cast<void*>(first + n),
+                   static_cast<const void*>(first),
+                   (last - first) * sizeof(value_type));
+    } else {
+      size_type tail = size_ - idx;
+      size_type raw = n < tail ? n : tail;
+      pointer src = last;
+      pointer dst = last + n;
+      for (size_type i = 0; i < raw; ++i) {
+        --src;
+        --dst;
+        alloc_.construct(dst, std::move(*src));
+      }
+      std::move_backward(first, src, dst);
+      for (pointer it = first; it != first + raw; ++it) alloc_.destroy(it);
+    }
+  }
+
+  // Removes [idx, idx + n) by shifting the tail forward and destroying what
+  // is left at the end.
+  void CloseGap(size_type idx, size_type n) {
+    if (n == 0) return;
+    pointer first = ptr_ + idx;
+    pointer last = first + n;
+    pointer end = ptr_ + size_;
+    if constexpr (std::is_trivially_copyable<value_type>::value) {
+      std::memmove(static_cast<void*>(first), static_cast<const void*>(last),
+                   (end - last) * sizeof(value_type));
+    } else {
+      pointer new_end = std::move(last, end, first);
+      for (; new_end != end; ++new_end) alloc_.destroy(new_end);
+    }
+    size_ -= n;
   }
 };
 